@@ -0,0 +1,106 @@
+/**
+Bybit Backfill Scheduler
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_BACKFILL_SCHEDULER_H
+#define INCLUDE_VK_BYBIT_BACKFILL_SCHEDULER_H
+
+#include "vk/bybit/bybit_models.h"
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vk::bybit {
+class RESTClient;
+
+enum class BackfillType : std::int32_t {
+    Candles,
+    FundingRates
+};
+
+struct BackfillJob {
+    BackfillType type{BackfillType::Candles};
+    Category category{Category::linear};
+    std::string symbol{};
+    CandleInterval interval{CandleInterval::_1};
+    std::int64_t from{};
+    std::int64_t to{};
+    /// Funding interval in minutes, it sizes the windows of funding rate jobs
+    int fundingInterval{480};
+};
+
+struct BackfillStats {
+    /// Fetched pages, a page of funding rates may take several requests
+    std::uint64_t pages{};
+    std::uint64_t candles{};
+    std::uint64_t fundingRates{};
+    std::uint64_t completedJobs{};
+    std::uint64_t failedJobs{};
+    std::chrono::milliseconds elapsed{};
+    double pagesPerSecond{};
+    double candlesPerSecond{};
+};
+
+using onBackfillCandles = std::function<void(const BackfillJob&, const std::vector<Candle>&)>;
+using onBackfillFundingRates = std::function<void(const BackfillJob&, const std::vector<FundingRate>&)>;
+
+/**
+ * Runs many backfill jobs over a pool of worker threads. Jobs are split into pages (time windows of one request) which
+ * are dealt round-robin to the workers, so all jobs progress at the same pace and share the rate limit of the
+ * RESTClient fairly. An idle worker steals pages from the others.
+ *
+ * Pages of a job are written in the chronological order, the writers of different jobs may run concurrently. The
+ * checkpoint file stores the time up to which every job was written, jobs added again after a crash resume from there.
+ */
+class BackfillScheduler {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+public:
+    /// Attempts of a page before its job fails
+    static constexpr int MAX_PAGE_ATTEMPTS = 3;
+
+    /**
+     * @param restClient shared by all workers
+     * @param numWorkers number of worker threads
+     * @param checkpointPath checkpoint file, no checkpoints if empty
+     */
+    explicit BackfillScheduler(std::shared_ptr<RESTClient> restClient, std::size_t numWorkers = 8,
+                               const std::filesystem::path& checkpointPath = {});
+
+    ~BackfillScheduler();
+
+    /**
+     * Add job, the range is shortened by the checkpoint. A job which is complete according to the checkpoint is skipped.
+     * @param job
+     */
+    void addJob(const BackfillJob& job) const;
+
+    /**
+     * Run all added jobs and block until they are finished or stop() is called
+     * @param candleWriter called with the candles of every page of the candle jobs
+     * @param fundingRateWriter called with the funding rates of every page of the funding rate jobs
+     * @throws std::runtime_error if the checkpoint could not be written at the end of the run
+     */
+    void run(const onBackfillCandles& candleWriter, const onBackfillFundingRates& fundingRateWriter = {}) const;
+
+    /**
+     * Stop the workers after their current pages, the checkpoint keeps the progress
+     */
+    void stop() const;
+
+    /**
+     * Get throughput of the current or the last run
+     * @return BackfillStats
+     */
+    [[nodiscard]] BackfillStats getStats() const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_BACKFILL_SCHEDULER_H
@@ -0,0 +1,43 @@
+/**
+Bybit Candle Codec
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_CANDLE_CODEC_H
+#define INCLUDE_VK_BYBIT_CANDLE_CODEC_H
+
+#include "vk/bybit/bybit_models.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vk::bybit {
+/**
+ * Lossless compression of candles in independent blocks of BLOCK_SIZE candles, stored column by column. Start times
+ * are encoded as delta-of-delta, which is a single bit for every candle of a series without gaps. Prices and volumes
+ * are XORed with the previous value of the column (Gorilla encoding), the open price with the previous close price,
+ * which it usually equals.
+ */
+class CandleCodec {
+public:
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::size_t BLOCK_SIZE = 1024;
+
+    /**
+     * @param candles in the chronological order
+     * @return encoded candles
+     */
+    [[nodiscard]] static std::string encode(const std::vector<Candle>& candles);
+
+    /**
+     * @param data encoded candles
+     * @return decoded candles
+     * @throws std::runtime_error if the data is damaged or of another version
+     */
+    [[nodiscard]] static std::vector<Candle> decode(std::string_view data);
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_CANDLE_CODEC_H
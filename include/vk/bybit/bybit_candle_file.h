@@ -0,0 +1,116 @@
+/**
+Bybit Candle File
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_CANDLE_FILE_H
+#define INCLUDE_VK_BYBIT_CANDLE_FILE_H
+
+#include "vk/bybit/bybit_models.h"
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace vk::bybit {
+enum class CandleFileMode : std::int32_t {
+    ReadOnly,
+    ReadWrite
+};
+
+/**
+ * Columns of the candles mapped from a CandleFile, the spans point directly to the mapped files. The view keeps its
+ * mapping alive, so it stays valid when the file grows.
+ */
+struct CandleColumns {
+    std::span<const std::int64_t> startTime{};
+    std::span<const double> open{};
+    std::span<const double> high{};
+    std::span<const double> low{};
+    std::span<const double> close{};
+    std::span<const double> volume{};
+    std::span<const double> turnover{};
+    std::shared_ptr<const void> mapping{};
+
+    [[nodiscard]] std::size_t size() const;
+
+    [[nodiscard]] bool empty() const;
+
+    /**
+     * Copy one candle out of the columns
+     * @param index
+     * @return Candle
+     */
+    [[nodiscard]] Candle candle(std::size_t index) const;
+
+    /**
+     * @param offset index of the first candle
+     * @param count number of candles
+     * @return view of a part of the columns sharing the mapping
+     */
+    [[nodiscard]] CandleColumns subrange(std::size_t offset, std::size_t count) const;
+};
+
+/**
+ * Append-only columnar candle file. The file is a directory with one array file per column (startTime, open, high, low,
+ * close, volume and turnover, native byte order), a sparse time index holding every INDEX_STRIDE-th start time and a
+ * header with the number of committed candles.
+ *
+ * Readers map the columns and binary-search them without any parsing or copying, the index keeps the search within
+ * a few pages of a multi-GB history. The writer appends the columns first and then publishes the new count in the
+ * header, readers never see a partially appended candle. Data behind the committed count, left by a crashed writer,
+ * is cut off when the next writer opens the file. There must be at most one writer at a time.
+ */
+class CandleFile {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+public:
+    static constexpr std::uint32_t VERSION = 1;
+
+    /// Number of candles per entry of the time index
+    static constexpr std::size_t INDEX_STRIDE = 1024;
+
+    /**
+     * @param directory the directory of the file, it is created in the ReadWrite mode if it does not exist
+     * @param mode
+     * @throws std::runtime_error, std::filesystem::filesystem_error, boost::interprocess::interprocess_exception
+     */
+    explicit CandleFile(const std::filesystem::path& directory, CandleFileMode mode = CandleFileMode::ReadOnly);
+
+    ~CandleFile();
+
+    /**
+     * Append the candles, candles which do not start after the last stored candle are skipped. Can be used as the
+     * writer of RESTClient::downloadHistoricalPrices().
+     * @param candles in the chronological order
+     * @return number of appended candles
+     * @throws std::runtime_error
+     */
+    std::size_t append(const std::vector<Candle>& candles) const;
+
+    /**
+     * Get number of committed candles, it includes the appends of other processes
+     * @return number of candles
+     */
+    [[nodiscard]] std::size_t size() const;
+
+    /**
+     * Map all committed candles
+     * @return CandleColumns
+     */
+    [[nodiscard]] CandleColumns columns() const;
+
+    /**
+     * Find the candles of the time range by binary search over the time index and the startTime column
+     * @param from timestamp in ms, INCLUSIVE
+     * @param to timestamp in ms, INCLUSIVE
+     * @return CandleColumns, empty if there are no candles in the range
+     */
+    [[nodiscard]] CandleColumns find(std::int64_t from, std::int64_t to) const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_CANDLE_FILE_H
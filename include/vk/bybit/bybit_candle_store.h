@@ -0,0 +1,97 @@
+/**
+Bybit Candle Store
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_CANDLE_STORE_H
+#define INCLUDE_VK_BYBIT_CANDLE_STORE_H
+
+#include "vk/bybit/bybit_models.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vk::bybit {
+class RESTClient;
+
+enum class CandleEncoding : std::int32_t {
+    Raw, ///< fixed size records
+    Compressed ///< CandleCodec blocks, about 1.6 times smaller on 1 minute candles
+};
+
+/// Range of candle start times in ms, both ends inclusive
+struct CandleRange {
+    std::int64_t from{};
+    std::int64_t to{};
+};
+
+/**
+ * Local store of closed candles per category, symbol and interval. The store remembers the ranges which were
+ * synchronized completely and a read downloads only the missing parts of the requested range. Holes in a downloaded
+ * range (missing candles between two stored ones) are downloaded once more before the range is marked complete, what
+ * is still missing then is remembered as a gap (e.g. a trading halt). Candles which are not closed yet are downloaded
+ * on every read and never stored.
+ *
+ * Every series lives in its own directory (directory/category/symbol/interval), the candles in chunk files of
+ * CANDLES_PER_CHUNK intervals, the synchronized ranges and the gaps in text files. Chunks of the other encoding are
+ * read as well and converted when they are written next time. All methods are thread safe, every series is locked
+ * separately and not during the downloads, so a read of stored candles does not wait for the sync of another series.
+ */
+class CandleStore {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+public:
+    /// Time span of a chunk file in intervals, e.g. 45 days of 1 minute candles
+    static constexpr std::int64_t CANDLES_PER_CHUNK = 65536;
+
+    /**
+     * @param restClient downloads the missing candles
+     * @param directory root directory of the store, it is created if it does not exist
+     * @param encoding of the written chunks
+     */
+    CandleStore(std::shared_ptr<RESTClient> restClient, const std::filesystem::path& directory,
+                CandleEncoding encoding = CandleEncoding::Raw);
+
+    ~CandleStore();
+
+    /**
+     * Get candles, only the ranges which are not stored yet are downloaded
+     * @param category i.e. Spot, Linear...
+     * @param symbol e.g. BTCUSDT
+     * @param interval
+     * @param from timestamp in ms, INCLUSIVE
+     * @param to timestamp in ms, INCLUSIVE
+     * @return vector of Candle structures in the chronological order
+     * @throws nlohmann::json::exception, std::exception
+     */
+    [[nodiscard]] std::vector<Candle> getCandles(Category category, const std::string& symbol, CandleInterval interval,
+                                                 std::int64_t from, std::int64_t to) const;
+
+    /**
+     * Get the ranges of the series which are stored completely
+     * @param category
+     * @param symbol
+     * @param interval
+     * @return ranges in the chronological order
+     */
+    [[nodiscard]] std::vector<CandleRange> getSynchronizedRanges(Category category, const std::string& symbol,
+                                                                 CandleInterval interval) const;
+
+    /**
+     * Check the stored candles for holes, e.g. after a chunk file was lost. Candles missing between the stored ones and
+     * at the edges of the synchronized ranges are holes unless they are gaps known from the download. The holes are
+     * removed from the synchronized ranges, so the next read downloads them again.
+     * @param category
+     * @param symbol
+     * @param interval
+     * @return number of holes found
+     */
+    std::size_t verify(Category category, const std::string& symbol, CandleInterval interval) const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_CANDLE_STORE_H
@@ -0,0 +1,77 @@
+/**
+Bybit DNS Cache
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_DNS_CACHE_H
+#define INCLUDE_VK_BYBIT_DNS_CACHE_H
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vk::bybit {
+/**
+ * Process-wide resolver cache shared by the REST and WebSocket sessions. Entries are refreshed asynchronously in
+ * the background before their TTL expires, so the resolver is hit by a caller only on the very first lookup of a host.
+ */
+class DNSCache {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+    DNSCache();
+
+public:
+    DNSCache(const DNSCache&) = delete;
+
+    DNSCache& operator=(const DNSCache&) = delete;
+
+    ~DNSCache();
+
+    /**
+     * Get the process-wide instance
+     * @return DNSCache instance
+     */
+    static DNSCache& instance();
+
+    /**
+     * Get all cached endpoints for the host, resolves synchronously if the host is not cached yet. Stale endpoints are
+     * returned when a background refresh fails.
+     * @param host e.g. api.bybit.com
+     * @param port e.g. 443
+     * @return Endpoints in the resolver order, connect should try them one by one
+     * @throws boost::system::system_error
+     */
+    [[nodiscard]] std::vector<boost::asio::ip::tcp::endpoint> resolve(const std::string& host, const std::string& port) const;
+
+    /**
+     * Get all cached endpoints for the host, resolves asynchronously on the executor of the calling coroutine if the
+     * host is not cached yet, so IO threads are never blocked by the resolver
+     * @param host e.g. api.bybit.com
+     * @param port e.g. 443
+     * @return Endpoints in the resolver order, connect should try them one by one
+     * @throws boost::system::system_error
+     */
+    [[nodiscard]] boost::asio::awaitable<std::vector<boost::asio::ip::tcp::endpoint>> resolveAsync(std::string host, std::string port) const;
+
+    /**
+     * Drop the cached endpoints of the host, e.g. when connect failed on all of them
+     * @param host
+     * @param port
+     */
+    void invalidate(const std::string& host, const std::string& port) const;
+
+    /**
+     * Set the time to live of cached entries, default is 60 s
+     * @param ttl
+     */
+    void setTimeToLive(std::chrono::seconds ttl) const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_DNS_CACHE_H
@@ -11,9 +11,30 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 
 #include "vk/interface/i_json.h"
 #include "vk/bybit/bybit_enums.h"
+#include "vk/bybit/bybit_json_view.h"
 #include <nlohmann/json.hpp>
 
 namespace vk::bybit {
+/**
+ * Stream message decoded in place, the views refer to the received frame and are valid only during the data event
+ * callback. Copy what must outlive it, e.g. into Event or the typed events.
+ */
+struct EventView {
+    std::string_view topic{};
+    ResponseType type{ResponseType::snapshot};
+    std::int64_t ts{};
+    JsonView data{};
+    /// The message has the success member, i.e. it is a control message like the reply to a subscription
+    bool isControl{false};
+
+    EventView() = default;
+
+    /**
+     * @param json whole message
+     */
+    explicit EventView(const JsonView& json);
+};
+
 struct Event final : IJson {
     std::string topic{};
     ResponseType type{ResponseType::snapshot};
@@ -25,6 +46,12 @@ struct Event final : IJson {
     [[nodiscard]] nlohmann::json toJson() const override;
 
     void fromJson(const nlohmann::json& json) override;
+
+    /**
+     * Copy the view, the data is parsed into the JSON DOM
+     * @param eventView
+     */
+    void fromEventView(const EventView& eventView);
 };
 
 struct EventTicker final : IJson {
@@ -39,7 +66,11 @@ struct EventTicker final : IJson {
 
     void fromJson(const nlohmann::json& json) override;
 
+    void fromJson(const JsonView& json);
+
     void loadEventData(const Event& event);
+
+    void loadEventData(const EventView& event);
 };
 
 struct EventCandlestick final : IJson {
@@ -58,6 +89,8 @@ struct EventCandlestick final : IJson {
     [[nodiscard]] nlohmann::json toJson() const override;
 
     void fromJson(const nlohmann::json& json) override;
+
+    void fromJson(const JsonView& json);
 };
 }
 #endif //INCLUDE_VK_BYBIT_EVENT_MODELS_H
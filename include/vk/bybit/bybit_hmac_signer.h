@@ -0,0 +1,42 @@
+/**
+Bybit HMAC Request Signer
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_HMAC_SIGNER_H
+#define INCLUDE_VK_BYBIT_HMAC_SIGNER_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace vk::bybit {
+/**
+ * HMAC-SHA256 signer keyed once per credential. The inner and outer digest states (key XOR ipad/opad) are computed in
+ * the constructor and only cloned for every signature, so the key schedule is not repeated.
+ */
+class HMACSigner {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+public:
+    /// Lowercase hex encoded SHA256 digest
+    using Signature = std::array<char, 64>;
+
+    explicit HMACSigner(const std::string& secret);
+
+    ~HMACSigner();
+
+    /**
+     * Sign the message, thread-safe
+     * @param message
+     * @param signature out: lowercase hex encoded signature
+     */
+    void sign(std::string_view message, Signature& signature) const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_HMAC_SIGNER_H
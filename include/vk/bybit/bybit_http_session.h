@@ -9,11 +9,15 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 #ifndef INCLUDE_VK_BYBIT_HTTP_SESSION_H
 #define INCLUDE_VK_BYBIT_HTTP_SESSION_H
 
+#include "vk/bybit/bybit_request_builder.h"
+#include "vk/bybit/bybit_request_options.h"
+#include "vk/bybit/bybit_server_clock.h"
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <string>
-#include <map>
 #include <nlohmann/json_fwd.hpp>
 
 namespace vk::bybit {
@@ -30,9 +34,57 @@ public:
 
     ~HTTPSession();
 
-    [[nodiscard]] http::response<http::string_body> get(const std::string& path, const std::map<std::string, std::string>& parameters) const;
+    [[nodiscard]] http::response<http::string_body> get(const RequestBuilder& request, const RequestOptions& options = {}) const;
 
-    [[nodiscard]] http::response<http::string_body> post(const std::string& path, const nlohmann::json& json) const;
+    [[nodiscard]] http::response<http::string_body> post(const std::string& path, const nlohmann::json& json, const RequestOptions& options = {}) const;
+
+    /**
+     * Send the GET request asynchronously. Connections used by the coroutine are bound to its executor and kept in
+     * the pool until the io_context of the executor is destroyed.
+     * @param request path and query parameters
+     * @param options deadlines and cancellation token
+     * @return HTTP response
+     * @throws boost::system::system_error
+     */
+    [[nodiscard]] net::awaitable<http::response<http::string_body>> getAsync(const RequestBuilder& request, const RequestOptions& options = {}) const;
+
+    /**
+     * Send the POST request asynchronously. Connections used by the coroutine are bound to its executor and kept in
+     * the pool until the io_context of the executor is destroyed.
+     * @param path e.g. /v5/order/create
+     * @param json request body
+     * @param options deadlines and cancellation token
+     * @return HTTP response
+     * @throws boost::system::system_error
+     */
+    [[nodiscard]] net::awaitable<http::response<http::string_body>> postAsync(const std::string& path, const nlohmann::json& json, const RequestOptions& options = {}) const;
+
+    /**
+     * Get executor of the internal IO thread which runs the synchronous requests
+     * @return executor
+     */
+    [[nodiscard]] net::any_io_executor executor() const;
+
+    /**
+     * Check whether the calling thread is the internal IO thread, blocking on a request there would wait for itself
+     * @return true if called on the IO thread
+     */
+    [[nodiscard]] bool isIOThread() const;
+
+    /**
+     * Set the receive window of signed requests, the request timestamp is taken from the server clock estimate, so
+     * a few hundred ms are enough on a stable connection. Default is 5000 ms.
+     * @param receiveWindow in ms
+     */
+    void setReceiveWindow(int receiveWindow) const;
+
+    [[nodiscard]] int receiveWindow() const;
+
+    /**
+     * Get the server clock estimate used to timestamp signed requests
+     * @return ServerClock
+     */
+    [[nodiscard]] const ServerClock& serverClock() const;
 };
 } // namespace vk::bybit
 #endif // INCLUDE_VK_BYBIT_HTTP_SESSION_H
@@ -0,0 +1,60 @@
+/**
+Bybit Instrument Cache
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_INSTRUMENT_CACHE_H
+#define INCLUDE_VK_BYBIT_INSTRUMENT_CACHE_H
+
+#include "vk/bybit/bybit_models.h"
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace vk::bybit {
+struct CachedCategory {
+    /// Time of the download of the category in ms
+    std::int64_t timestamp{};
+    std::vector<Instrument> instruments{};
+};
+
+struct InstrumentCacheContent {
+    std::map<Category, CachedCategory> categories{};
+};
+
+/**
+ * Compact binary file with the instruments of all categories, so the tick and lot sizes are known right after the start
+ * without downloading them. The file holds a magic, the format version, the time of the download of every category and
+ * a checksum, a file of another version or a damaged one is ignored. Numbers are stored in the native byte order.
+ *
+ * The file is replaced by rename, readers never see a partially written file.
+ */
+class InstrumentCacheFile {
+    std::filesystem::path m_path{};
+
+public:
+    static constexpr std::uint32_t VERSION = 2;
+
+    explicit InstrumentCacheFile(std::filesystem::path path);
+
+    /**
+     * Read the file
+     * @return content, empty if the file does not exist, has another version or is damaged
+     */
+    [[nodiscard]] std::optional<InstrumentCacheContent> load() const;
+
+    /**
+     * Write the file
+     * @param content
+     * @throws std::runtime_error, std::filesystem::filesystem_error
+     */
+    void save(const InstrumentCacheContent& content) const;
+
+    [[nodiscard]] const std::filesystem::path& path() const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_INSTRUMENT_CACHE_H
@@ -0,0 +1,151 @@
+/**
+Bybit JSON View
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_JSON_VIEW_H
+#define INCLUDE_VK_BYBIT_JSON_VIEW_H
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+namespace vk::bybit {
+/**
+ * On-demand view of a JSON value inside a buffer, nothing is parsed or copied until a value is asked for. Members and
+ * elements are found by skipping over the values before them, which is cheap for the small objects of the stream
+ * messages. The view refers to the buffer, it must not outlive it.
+ *
+ * Strings are returned raw, escape sequences are not resolved (Bybit does not use them in keys, symbols and numbers).
+ * Malformed JSON throws std::runtime_error when it is reached.
+ */
+class JsonView {
+    std::string_view m_json{};
+
+public:
+    /**
+     * Iterates over the elements of an array or the members of an object
+     */
+    class Iterator {
+        std::string_view m_rest{};
+        std::string_view m_key{};
+        std::string_view m_value{};
+        bool m_isObject = false;
+
+        void next();
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JsonView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = JsonView;
+
+        Iterator() = default;
+
+        /**
+         * @param elements text after the opening bracket of an array or an object
+         * @param isObject
+         */
+        Iterator(std::string_view elements, bool isObject);
+
+        /**
+         * @return key of the current member of an object, empty for arrays
+         */
+        [[nodiscard]] std::string_view key() const {
+            return m_key;
+        }
+
+        JsonView operator*() const {
+            return JsonView(m_value);
+        }
+
+        Iterator& operator++() {
+            next();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto retVal = *this;
+            next();
+            return retVal;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return m_value.data() == other.m_value.data();
+        }
+    };
+
+    JsonView() = default;
+
+    /**
+     * @param json text of one JSON value, surrounding whitespace is allowed
+     */
+    explicit JsonView(std::string_view json);
+
+    /**
+     * @return true if the value is missing, e.g. the view of a member which does not exist
+     */
+    [[nodiscard]] bool empty() const {
+        return m_json.empty();
+    }
+
+    [[nodiscard]] bool isObject() const {
+        return !m_json.empty() && m_json.front() == '{';
+    }
+
+    [[nodiscard]] bool isArray() const {
+        return !m_json.empty() && m_json.front() == '[';
+    }
+
+    [[nodiscard]] bool isString() const {
+        return !m_json.empty() && m_json.front() == '"';
+    }
+
+    /**
+     * @return text of the value
+     */
+    [[nodiscard]] std::string_view raw() const {
+        return m_json;
+    }
+
+    /**
+     * Find the member of an object
+     * @param key
+     * @return view of the member, empty if it does not exist or this is not an object
+     */
+    [[nodiscard]] JsonView operator[](std::string_view key) const;
+
+    /**
+     * @return content of a string without the quotes, the raw text of other values
+     */
+    [[nodiscard]] std::string_view asString() const;
+
+    /**
+     * Read a number, Bybit sends most numbers as strings so both are accepted
+     * @param defaultValue returned if the value is missing, empty or not a number
+     */
+    [[nodiscard]] double asDouble(double defaultValue = 0.0) const;
+
+    /**
+     * @copydoc asDouble()
+     */
+    [[nodiscard]] std::int64_t asInt64(std::int64_t defaultValue = 0) const;
+
+    /**
+     * @param defaultValue returned if the value is not true or false
+     */
+    [[nodiscard]] bool asBool(bool defaultValue = false) const;
+
+    /**
+     * @return iterator over the elements of an array or the members of an object, end() for other values
+     */
+    [[nodiscard]] Iterator begin() const;
+
+    [[nodiscard]] Iterator end() const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_JSON_VIEW_H
@@ -0,0 +1,157 @@
+/**
+Bybit Order Book
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_ORDER_BOOK_H
+#define INCLUDE_VK_BYBIT_ORDER_BOOK_H
+
+#include "vk/bybit/bybit_event_models.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vk::bybit {
+struct OrderBookLevel {
+    double price{};
+    double size{};
+};
+
+/// Bid and ask of the same rank
+struct OrderBookRank {
+    OrderBookLevel bid{};
+    OrderBookLevel ask{};
+};
+
+/**
+ * Best levels of a local order book, trivially copyable so it can be published to the readers without a lock. The
+ * sides are interleaved by rank, so the best N levels of both sides are a prefix of the structure and only the prefix
+ * is copied.
+ */
+struct EventOrderBook {
+    static constexpr std::size_t MAX_LEVELS = 50;
+
+    std::int64_t ts{};
+    std::int64_t updateId{};
+    std::int64_t seq{};
+    /// False while the book waits for a snapshot, e.g. after a missed update
+    bool synchronized{false};
+    std::size_t numBids{};
+    std::size_t numAsks{};
+    /// From the best price, only the first numBids bids and numAsks asks are valid
+    std::array<OrderBookRank, MAX_LEVELS> levels{};
+
+    /**
+     * @param index 0 is the best (highest) bid, must be less than numBids
+     */
+    [[nodiscard]] const OrderBookLevel& bid(const std::size_t index) const {
+        return levels[index].bid;
+    }
+
+    /**
+     * @param index 0 is the best (lowest) ask, must be less than numAsks
+     */
+    [[nodiscard]] const OrderBookLevel& ask(const std::size_t index) const {
+        return levels[index].ask;
+    }
+
+    /**
+     * @param numLevels at most MAX_LEVELS
+     * @return number of bytes from the beginning of the structure holding the best numLevels levels
+     */
+    static constexpr std::size_t sizeWithLevels(const std::size_t numLevels) {
+        return offsetof(EventOrderBook, levels) + numLevels * sizeof(OrderBookRank);
+    }
+};
+
+enum class OrderBookUpdate : std::int32_t {
+    Applied,
+    /// Old or duplicate delta, or a delta before the first snapshot
+    Ignored,
+    /// A delta was missed, the book is cleared and must be resynchronized by a new snapshot
+    Gap
+};
+
+/**
+ * Local L2 order book maintained from the snapshot and delta messages of the orderbook.{depth}.{symbol} streams. Every
+ * side is a flat array of levels sorted so the best price is at the back, most updates touch the top of the book and
+ * shift only the few levels behind it. Deltas must continue the update id (u) of the previous message, otherwise the
+ * book reports a gap.
+ *
+ * Not thread safe, it is updated and read by the IO thread.
+ */
+class OrderBook {
+    /// Ascending, the best bid is the last one
+    std::vector<OrderBookLevel> m_bids{};
+    /// Descending, the best ask is the last one
+    std::vector<OrderBookLevel> m_asks{};
+    std::int64_t m_ts{};
+    std::int64_t m_updateId{};
+    std::int64_t m_seq{};
+    bool m_synchronized = false;
+
+public:
+    /**
+     * Apply a snapshot or a delta message
+     * @param event message of an orderbook stream, its data holds the levels b, a and the ids u, seq
+     * @return OrderBookUpdate
+     * @throws std::runtime_error on malformed data
+     */
+    OrderBookUpdate update(const EventView& event);
+
+    /**
+     * Clear the book, it waits for the next snapshot
+     */
+    void reset();
+
+    [[nodiscard]] bool isSynchronized() const {
+        return m_synchronized;
+    }
+
+    [[nodiscard]] std::int64_t ts() const {
+        return m_ts;
+    }
+
+    [[nodiscard]] std::int64_t updateId() const {
+        return m_updateId;
+    }
+
+    [[nodiscard]] std::int64_t seq() const {
+        return m_seq;
+    }
+
+    [[nodiscard]] std::size_t numBids() const {
+        return m_bids.size();
+    }
+
+    [[nodiscard]] std::size_t numAsks() const {
+        return m_asks.size();
+    }
+
+    /**
+     * @param index 0 is the best bid, must be less than numBids()
+     */
+    [[nodiscard]] const OrderBookLevel& bid(const std::size_t index) const {
+        return m_bids[m_bids.size() - 1 - index];
+    }
+
+    /**
+     * @param index 0 is the best ask, must be less than numAsks()
+     */
+    [[nodiscard]] const OrderBookLevel& ask(const std::size_t index) const {
+        return m_asks[m_asks.size() - 1 - index];
+    }
+
+    /**
+     * Copy the best levels
+     * @param event
+     * @param numLevels at most MAX_LEVELS levels of each side are copied
+     */
+    void top(EventOrderBook& event, std::size_t numLevels = EventOrderBook::MAX_LEVELS) const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_ORDER_BOOK_H
@@ -0,0 +1,99 @@
+/**
+Bybit Rate Limiter
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_RATE_LIMITER_H
+#define INCLUDE_VK_BYBIT_RATE_LIMITER_H
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/beast/http/fields.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace vk::bybit {
+namespace net = boost::asio;
+
+/// Waiting requests of a higher priority are always served first
+enum class RequestPriority : std::int32_t {
+    High, ///< order placement and cancellation
+    Normal,
+    Low ///< bulk downloads, e.g. candles and funding rates
+};
+
+/**
+ * Token bucket scheduler with one bucket per endpoint group (Bybit limits every endpoint separately). Buckets refill
+ * continuously at the rate of the limit per second, the server state from the X-Bapi-Limit* response headers caps
+ * the local estimate. Every request then takes a token from the bucket of the IP address limit (600 requests per 5 s
+ * over all endpoints), that is where the priorities of different endpoint groups compete. Waiting requests are queued
+ * in priority lanes and suspended on their own executors, the lock is never held while waiting. The first waiter of
+ * the highest lane sleeps until the next token, the others until they are notified.
+ *
+ * The coroutines waiting in acquire() must run on a single threaded io_context or a strand.
+ *
+ * With shareBudget() the bucket states move to a shared memory segment joined by all processes using the same API key.
+ * Tokens are taken and the server state is applied by CAS on the segment, the priority lanes stay per process. The
+ * IP address bucket is shared as well, the processes are expected to run on the same host.
+ */
+class RateLimiter {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+public:
+    /// Conservative default, Bybit does not send the rate limit headers for public endpoints
+    static constexpr std::int32_t DEFAULT_REQUESTS_PER_SECOND = 10;
+
+    /// Capacity of the shared memory table, groups which do not fit keep a process local bucket
+    static constexpr std::size_t MAX_SHARED_GROUPS = 256;
+
+    RateLimiter();
+
+    ~RateLimiter();
+
+    /**
+     * Take a token from the bucket of the group, waits asynchronously when the bucket is empty
+     * @param group endpoint group, e.g. /v5/order/create
+     * @param priority
+     */
+    [[nodiscard]] net::awaitable<void> acquire(std::string_view group, RequestPriority priority) const;
+
+    /**
+     * Update the bucket of the group from the response headers X-Bapi-Limit, X-Bapi-Limit-Status and
+     * X-Bapi-Limit-Reset-Timestamp
+     * @param group endpoint group
+     * @param fields response headers
+     */
+    void update(std::string_view group, const boost::beast::http::fields& fields) const;
+
+    /**
+     * Set the rate of groups whose limit is not known from the response headers
+     * @param requestsPerSecond
+     */
+    void setDefaultLimit(std::int32_t requestsPerSecond) const;
+
+    /**
+     * Get the number of requests waiting for a token
+     * @return number of waiting requests in all groups
+     */
+    [[nodiscard]] std::size_t numWaiting() const;
+
+    /**
+     * Share the budget with other processes, the segment is created by the first process and outlives all of them
+     * @param name shared memory segment name, e.g. derived from the API key
+     * @throws boost::interprocess::interprocess_exception, std::runtime_error
+     */
+    void shareBudget(const std::string& name) const;
+
+    /**
+     * Remove the shared memory segment, processes which joined it keep their mapping
+     * @param name shared memory segment name
+     */
+    static void removeSharedBudget(const std::string& name);
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_RATE_LIMITER_H
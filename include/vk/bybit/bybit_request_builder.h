@@ -0,0 +1,142 @@
+/**
+Bybit REST Request Builder
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_REQUEST_BUILDER_H
+#define INCLUDE_VK_BYBIT_REQUEST_BUILDER_H
+
+#include "vk/bybit/bybit_enums.h"
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace vk::bybit {
+/**
+ * Append-only character buffer stored inline (e.g. on the stack), it spills to the heap only when the capacity is
+ * exceeded
+ */
+template<std::size_t Capacity>
+class InlineBuffer {
+    std::array<char, Capacity> m_inline;
+    std::size_t m_size = 0;
+    std::string m_heap;
+
+public:
+    void append(const std::string_view str) {
+        if (m_heap.empty() && m_size + str.size() <= Capacity) {
+            std::memcpy(m_inline.data() + m_size, str.data(), str.size());
+            m_size += str.size();
+            return;
+        }
+
+        if (m_heap.empty()) {
+            m_heap.reserve(2 * Capacity + str.size());
+            m_heap.assign(m_inline.data(), m_size);
+        }
+
+        m_heap.append(str);
+    }
+
+    void append(const char c) { append(std::string_view(&c, 1)); }
+
+    template<std::integral T>
+    void append(const T value) {
+        char digits[24];
+        const auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        append(std::string_view(digits, static_cast<std::size_t>(ptr - digits)));
+    }
+
+    [[nodiscard]] std::string_view view() const { return m_heap.empty() ? std::string_view(m_inline.data(), m_size) : std::string_view(m_heap); }
+
+    [[nodiscard]] std::size_t size() const { return view().size(); }
+
+    /**
+     * Check if the content still fits into the inline storage
+     * @return False if the buffer spilled to the heap
+     */
+    [[nodiscard]] bool isInline() const { return m_heap.empty(); }
+};
+
+/**
+ * Builds the request target (path and query string) of a REST call in one pass into an inline buffer, typical requests
+ * need no heap allocation. Parameters are sent (and signed) in the order they were added.
+ */
+class RequestBuilder {
+public:
+    static constexpr std::size_t INLINE_CAPACITY = 512;
+    using SignaturePayload = InlineBuffer<1024>;
+
+private:
+    InlineBuffer<INLINE_CAPACITY> m_target;
+    std::size_t m_pathSize = 0;
+
+public:
+    explicit RequestBuilder(const std::string_view path) : m_pathSize(path.size()) { m_target.append(path); }
+
+    /**
+     * Add query parameter
+     * @param key e.g. symbol
+     * @param value string, integral number or enum (written as its magic_enum name)
+     * @return this builder
+     */
+    template<typename ValueType>
+    RequestBuilder& add(const std::string_view key, const ValueType& value) {
+        m_target.append(m_target.size() == m_pathSize ? '?' : '&');
+        m_target.append(key);
+        m_target.append('=');
+
+        if constexpr (std::is_enum_v<ValueType>) {
+            m_target.append(magic_enum::enum_name(value));
+        } else if constexpr (std::integral<ValueType>) {
+            m_target.append(value);
+        } else {
+            m_target.append(std::string_view(value));
+        }
+
+        return *this;
+    }
+
+    /**
+     * Get the path
+     * @return e.g. /v5/market/tickers
+     */
+    [[nodiscard]] std::string_view path() const { return m_target.view().substr(0, m_pathSize); }
+
+    /**
+     * Get the request target
+     * @return e.g. /v5/market/tickers?category=linear&symbol=BTCUSDT
+     */
+    [[nodiscard]] std::string_view target() const { return m_target.view(); }
+
+    /**
+     * Get the query string
+     * @return e.g. category=linear&symbol=BTCUSDT, empty if there are no parameters
+     */
+    [[nodiscard]] std::string_view query() const {
+        const auto target = m_target.view();
+        return target.size() > m_pathSize ? target.substr(m_pathSize + 1) : std::string_view();
+    }
+
+    /**
+     * Write the payload which is signed for GET requests: timestamp + API key + receive window + query string
+     * @param timestamp in ms
+     * @param apiKey
+     * @param receiveWindow in ms
+     * @param payload out: signature payload
+     */
+    void writeSignaturePayload(const std::int64_t timestamp, const std::string_view apiKey, const int receiveWindow, SignaturePayload& payload) const {
+        payload.append(timestamp);
+        payload.append(apiKey);
+        payload.append(receiveWindow);
+        payload.append(query());
+    }
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_REQUEST_BUILDER_H
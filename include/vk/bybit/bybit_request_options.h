@@ -0,0 +1,105 @@
+/**
+Bybit Request Options
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_REQUEST_OPTIONS_H
+#define INCLUDE_VK_BYBIT_REQUEST_OPTIONS_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace vk::bybit {
+/**
+ * Time budgets of the request phases, a phase which does not complete in time fails with beast::error::timeout.
+ * Connect and TLS apply only when a new connection is dialed, reused connections skip them.
+ */
+struct RequestDeadlines {
+    std::chrono::milliseconds connect{5000};
+    std::chrono::milliseconds tls{5000};
+    std::chrono::milliseconds write{5000};
+    std::chrono::milliseconds read{10000};
+};
+
+/**
+ * Cancels pending requests from any thread. Copies share the state, so the caller keeps one copy and passes another
+ * one with the requests. Once cancelled the token stays cancelled.
+ */
+class CancellationToken {
+    struct State {
+        std::mutex locker;
+        bool cancelled = false;
+        std::size_t nextHandlerId = 0;
+        std::map<std::size_t, std::function<void()>> handlers;
+    };
+
+    std::shared_ptr<State> m_state = std::make_shared<State>();
+
+public:
+    /**
+     * Cancel the token and run all registered handlers, handlers run on the calling thread
+     */
+    void cancel() const {
+        std::map<std::size_t, std::function<void()>> handlers;
+        {
+            std::lock_guard lk(m_state->locker);
+
+            if (m_state->cancelled) {
+                return;
+            }
+
+            m_state->cancelled = true;
+            handlers.swap(m_state->handlers);
+        }
+
+        for (const auto& [id, handler]: handlers) {
+            handler();
+        }
+    }
+
+    [[nodiscard]] bool isCancelled() const {
+        std::lock_guard lk(m_state->locker);
+        return m_state->cancelled;
+    }
+
+    /**
+     * Register the handler called on cancellation, it is called immediately if the token is cancelled already
+     * @param handler must not block, usually it posts the cancellation to the executor of the operation
+     * @return handler id for unregisterHandler(), 0 if the handler was called immediately
+     */
+    std::size_t registerHandler(std::function<void()> handler) const {
+        {
+            std::lock_guard lk(m_state->locker);
+
+            if (!m_state->cancelled) {
+                const auto id = ++m_state->nextHandlerId;
+                m_state->handlers.emplace(id, std::move(handler));
+                return id;
+            }
+        }
+
+        handler();
+        return 0;
+    }
+
+    void unregisterHandler(const std::size_t id) const {
+        std::lock_guard lk(m_state->locker);
+        m_state->handlers.erase(id);
+    }
+};
+
+struct RequestOptions {
+    RequestDeadlines deadlines{};
+
+    /// Cancelled requests fail with boost::asio::error::operation_aborted
+    std::optional<CancellationToken> cancellationToken{};
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_REQUEST_OPTIONS_H
@@ -10,20 +10,57 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 #define INCLUDE_VK_BYBIT_FUTURES_REST_CLIENT_H
 
 #include "vk/bybit/bybit_models.h"
+#include "vk/bybit/bybit_request_options.h"
+#include <boost/asio/awaitable.hpp>
+#include <filesystem>
 #include <string>
 #include <memory>
 #include <optional>
 
 namespace vk::bybit {
+namespace net = boost::asio;
 
 using onCandlesDownloaded = std::function<void(const std::vector<Candle>&)>;
 
+/// Endpoints sharing the request deadlines
+enum class EndpointClass : std::int32_t {
+    MarketData, ///< tickers, server time
+    History, ///< klines, funding rates, instruments info
+    Account, ///< wallet, positions, open orders, position mode
+    Trade ///< order placement and cancellation
+};
+
+struct HedgingStats {
+    /// Duplicate requests sent because the first attempt did not answer within the p95 latency
+    std::uint64_t hedgesFired = 0;
+    /// Duplicate requests which answered before the first attempt
+    std::uint64_t hedgesWon = 0;
+};
+
+/**
+ * Every method has an asynchronous variant (the "Async" suffix) returning an awaitable, it runs on the executor of the
+ * calling coroutine (i.e. on a caller-provided io_context) and it does not block the thread. The pooled connections
+ * are bound to the io_context and dropped when it is destroyed, so it may go away before the RESTClient. Arguments
+ * passed by reference must stay valid until the awaitable completes. The blocking methods run their asynchronous
+ * variants on the internal IO thread and the candle callbacks on the calling thread. They throw std::runtime_error
+ * when called on the IO thread itself.
+ *
+ * The executor of the calling coroutine must not run handlers concurrently: an io_context run by a single thread, or
+ * one strand used for all calls. The concurrent downloads, the hedged requests and the rate limiter share state
+ * between the coroutines they spawn on that executor without locking. Connections are pooled per executor, so a new
+ * strand per call would also dial a new connection every time.
+ */
 class RESTClient {
     struct P;
     std::unique_ptr<P> m_p{};
 
 public:
-    RESTClient(const std::string& apiKey, const std::string& apiSecret);
+    /**
+     * @param apiKey
+     * @param apiSecret
+     * @param instrumentCachePath instrument cache file, see enableInstrumentCache(), no cache if empty
+     */
+    RESTClient(const std::string& apiKey, const std::string& apiSecret, const std::filesystem::path& instrumentCachePath = {});
 
     ~RESTClient();
 
@@ -34,6 +71,66 @@ public:
      */
     void setCredentials(const std::string& apiKey, const std::string& apiSecret) const;
 
+    /**
+     * Set the receive window of signed requests, requests are timestamped by the estimated server clock, so a few
+     * hundred ms are enough on a stable connection. Default is 5000 ms.
+     * @param receiveWindow in ms
+     * @see https://bybit-exchange.github.io/docs/v5/guide#parameters-for-authenticated-endpoints
+     */
+    void setReceiveWindow(int receiveWindow) const;
+
+    /**
+     * Persist the instruments to the file. The instruments stored in the file are loaded immediately, so orders can be
+     * placed without waiting for the instruments info, and their categories are refreshed in the background. The
+     * destructor cancels the refresh and waits for it. A category downloaded more than 24 hours ago is not loaded.
+     * Every download of all instruments of a category rewrites the file with the fully downloaded categories, single
+     * symbols downloaded on the order path are not persisted.
+     * @param path
+     */
+    void enableInstrumentCache(const std::filesystem::path& path) const;
+
+    /**
+     * Set deadlines of the endpoint class, a request whose phase does not complete in time fails with
+     * boost::system::system_error (beast::error::timeout), so the caller can fail over instead of hanging
+     * @param endpointClass
+     * @param deadlines
+     */
+    void setDeadlines(EndpointClass endpointClass, const RequestDeadlines& deadlines) const;
+
+    [[nodiscard]] RequestDeadlines getDeadlines(EndpointClass endpointClass) const;
+
+    /**
+     * Abort all pending requests from any thread, they fail with boost::system::system_error (operation_aborted).
+     * Requests started later are not affected.
+     */
+    void cancelPendingRequests() const;
+
+    /**
+     * Enable hedging of the idempotent latency critical requests: getTickers(), getServerTime() and getPositionInfo().
+     * When the first attempt does not answer within the p95 latency of the endpoint, a duplicate is sent on another
+     * pooled connection and the first response wins. Both attempts are charged to the rate limit, no duplicate is sent
+     * while other requests wait for the limiter. Disabled by default.
+     * @param enabled
+     */
+    void setHedging(bool enabled) const;
+
+    /**
+     * Join the rate limit budget shared by all processes using the same API key (a shared memory segment), so that
+     * several processes together do not exceed the limits. Call it before the first request and again after
+     * setCredentials() with another key.
+     * @throws boost::interprocess::interprocess_exception, std::runtime_error
+     */
+    void shareRateLimit() const;
+
+    /**
+     * Get the name of the shared memory segment of the API key, e.g. to remove it by RateLimiter::removeSharedBudget()
+     * @param apiKey
+     * @return segment name
+     */
+    [[nodiscard]] static std::string sharedRateLimitName(const std::string& apiKey);
+
+    [[nodiscard]] HedgingStats getHedgingStats() const;
+
     /**
      * Download historical candles
      * @param category i.e. Spot, Linear...
@@ -42,7 +139,8 @@ public:
      * @param from timestamp in ms, must be smaller than "to"
      * @param to timestamp in ms, must be bigger than "from"
      * @param limit maximum number of returned candles, maximum and also the default values is 200
-     * @param writer
+     * @param writer called with every page after it is cut to the range, see streamHistoricalPrices() to download
+     * without accumulating the result
      * @return vector of Candle structures
      * @throws nlohmann::json::exception, std::exception
      * @see https://bybit-exchange.github.io/docs/v5/market/kline
@@ -52,6 +150,66 @@ public:
                         std::int64_t to,
                         std::int32_t limit = 200, const onCandlesDownloaded &writer = {}) const;
 
+    /**
+     * Asynchronous variant of getHistoricalPrices()
+     */
+    [[nodiscard]] net::awaitable<std::vector<Candle>>
+    getHistoricalPricesAsync(Category category, const std::string& symbol, CandleInterval interval, std::int64_t from,
+                             std::int64_t to,
+                             std::int32_t limit = 200, const onCandlesDownloaded &writer = {}) const;
+
+    /**
+     * Download historical candles page by page and hand every page to the sink instead of accumulating them. The next
+     * page is downloaded while the sink processes the current one, so at most two pages of 1000 candles are held in
+     * memory and a slow sink slows the download down. The sink runs on the calling thread while the next page is being
+     * downloaded, it may call the blocking methods of the RESTClient.
+     * @param category i.e. Spot, Linear...
+     * @param symbol e.g. BTCUSDT
+     * @param interval
+     * @param from timestamp in ms, INCLUSIVE
+     * @param to timestamp in ms, INCLUSIVE
+     * @param sink called for every non-empty page in the chronological order
+     * @return number of candles passed to the sink
+     * @throws nlohmann::json::exception, std::exception, exceptions of the sink
+     * @see https://bybit-exchange.github.io/docs/v5/market/kline
+     */
+    std::size_t streamHistoricalPrices(Category category, const std::string& symbol, CandleInterval interval, std::int64_t from,
+                                       std::int64_t to, const onCandlesDownloaded& sink) const;
+
+    /**
+     * Asynchronous variant of streamHistoricalPrices(), the sink runs on the executor of the caller
+     */
+    [[nodiscard]] net::awaitable<std::size_t>
+    streamHistoricalPricesAsync(Category category, const std::string& symbol, CandleInterval interval, std::int64_t from,
+                                std::int64_t to, const onCandlesDownloaded& sink) const;
+
+    /**
+     * Download historical candles concurrently, the range is split into windows of 1000 candles (the maximum page
+     * size) which are fetched in parallel over the connection pool within the rate limit
+     * @param category i.e. Spot, Linear...
+     * @param symbol e.g. BTCUSDT
+     * @param interval
+     * @param from timestamp in ms, must be smaller than "to"
+     * @param to timestamp in ms, must be bigger than "from"
+     * @param writer called for every window in the chronological order
+     * @param maxConcurrentRequests number of windows downloaded at the same time
+     * @return vector of Candle structures in the chronological order
+     * @throws nlohmann::json::exception, std::exception
+     * @see https://bybit-exchange.github.io/docs/v5/market/kline
+     */
+    [[nodiscard]] std::vector<Candle>
+    downloadHistoricalPrices(Category category, const std::string& symbol, CandleInterval interval, std::int64_t from,
+                             std::int64_t to, const onCandlesDownloaded &writer = {},
+                             std::size_t maxConcurrentRequests = 4) const;
+
+    /**
+     * Asynchronous variant of downloadHistoricalPrices(), the windows are downloaded on the executor of the caller
+     */
+    [[nodiscard]] net::awaitable<std::vector<Candle>>
+    downloadHistoricalPricesAsync(Category category, const std::string& symbol, CandleInterval interval, std::int64_t from,
+                                  std::int64_t to, const onCandlesDownloaded &writer = {},
+                                  std::size_t maxConcurrentRequests = 4) const;
+
     /**
      * Get wallet balance info
      * @param coin e.g. USDT, returns all wallet balances if empty
@@ -62,6 +220,11 @@ public:
      */
     [[nodiscard]] WalletBalance getWalletBalance(AccountType accountType, const std::string& coin = "") const;
 
+    /**
+     * Asynchronous variant of getWalletBalance()
+     */
+    [[nodiscard]] net::awaitable<WalletBalance> getWalletBalanceAsync(AccountType accountType, const std::string& coin = "") const;
+
     /**
      * Returns server time in ms
      * @return timestamp in ms
@@ -70,6 +233,11 @@ public:
     */
     [[nodiscard]] std::int64_t getServerTime() const;
 
+    /**
+     * Asynchronous variant of getServerTime()
+     */
+    [[nodiscard]] net::awaitable<std::int64_t> getServerTimeAsync() const;
+
     /**
      * Get position info - if Hedge mode is enabled then there is more than one Position
      * @param category i.e. Spot, Linear...
@@ -81,7 +249,12 @@ public:
     [[nodiscard]] std::vector<Position> getPositionInfo(Category category, const std::string& symbol = "") const;
 
     /**
-     * Get instruments info
+     * Asynchronous variant of getPositionInfo()
+     */
+    [[nodiscard]] net::awaitable<std::vector<Position>> getPositionInfoAsync(Category category, const std::string& symbol = "") const;
+
+    /**
+     * Get instruments info, the instruments are cached per category. A single symbol request refreshes only its entry.
      * @param category i.e. Spot, Linear...
      * @param symbol e.g. BTCUSDT or empty for all symbols
      * @param force Reload instruments info from server if true
@@ -92,6 +265,12 @@ public:
     [[nodiscard]] std::vector<Instrument> getInstrumentsInfo(Category category, const std::string& symbol = "",
                                                              bool force = false) const;
 
+    /**
+     * Asynchronous variant of getInstrumentsInfo()
+     */
+    [[nodiscard]] net::awaitable<std::vector<Instrument>> getInstrumentsInfoAsync(Category category, const std::string& symbol = "",
+                                                                                  bool force = false) const;
+
     /**
      * Switching between One-Way Mode and Hedge Mode
      * @param category i.e. Spot, Linear...
@@ -105,6 +284,12 @@ public:
     [[nodiscard]] bool setPositionMode(Category category, const std::string& symbol, const std::string& coin,
                                        PositionMode positionMode) const;
 
+    /**
+     * Asynchronous variant of setPositionMode()
+     */
+    [[nodiscard]] net::awaitable<bool> setPositionModeAsync(Category category, const std::string& symbol, const std::string& coin,
+                                                            PositionMode positionMode) const;
+
     /**
      * Place order
      * @param order Requested order
@@ -114,6 +299,11 @@ public:
     */
     [[nodiscard]] OrderId placeOrder(Order& order) const;
 
+    /**
+     * Asynchronous variant of placeOrder(), the order must stay valid until the awaitable completes
+     */
+    [[nodiscard]] net::awaitable<OrderId> placeOrderAsync(Order& order) const;
+
     /**
      * Get open orders list
      * @param category i.e. Spot, Linear...
@@ -124,6 +314,11 @@ public:
      */
     [[nodiscard]] std::vector<OrderResponse> getOpenOrders(Category category, const std::string& symbol) const;
 
+    /**
+     * Asynchronous variant of getOpenOrders()
+     */
+    [[nodiscard]] net::awaitable<std::vector<OrderResponse>> getOpenOrdersAsync(Category category, const std::string& symbol) const;
+
     /**
      * Get open order. Because order creation/cancellation is asynchronous, there can be a data delay in this
      * endpoint. You can get real-time order info with the Query Active Order (real-time) endpoint.
@@ -138,6 +333,13 @@ public:
     getOpenOrder(Category category, const std::string& symbol, const std::string& orderId,
                  const std::string& orderLinkId) const;
 
+    /**
+     * Asynchronous variant of getOpenOrder()
+     */
+    [[nodiscard]] net::awaitable<std::optional<OrderResponse>>
+    getOpenOrderAsync(Category category, const std::string& symbol, const std::string& orderId,
+                      const std::string& orderLinkId) const;
+
     /**
      * Cancel all orders for a given symbol
      * @param category i.e. Spot, Linear...
@@ -147,6 +349,11 @@ public:
      */
     [[nodiscard]] std::vector<OrderId> cancelAllOrders(Category category, const std::string& symbol = "") const;
 
+    /**
+     * Asynchronous variant of cancelAllOrders()
+     */
+    [[nodiscard]] net::awaitable<std::vector<OrderId>> cancelAllOrdersAsync(Category category, const std::string& symbol = "") const;
+
     /**
      * Cancel order
      * @param category i.e. Spot, Linear...
@@ -162,10 +369,18 @@ public:
                 const std::string& orderLinkId = "") const;
 
     /**
-     * Set instruments
+     * Asynchronous variant of cancelOrder()
+     */
+    [[nodiscard]] net::awaitable<OrderId>
+    cancelOrderAsync(Category category, const std::string& symbol, const std::string& orderId = "",
+                     const std::string& orderLinkId = "") const;
+
+    /**
+     * Set instruments, replaces the cached instruments of the category
      * @param instruments
+     * @param category
      */
-    void setInstruments(const std::vector<Instrument>& instruments) const;
+    void setInstruments(const std::vector<Instrument>& instruments, Category category = Category::linear) const;
 
     /**
      * Close all open positions with market order
@@ -174,18 +389,32 @@ public:
     void closeAllPositions(Category category) const;
 
     /**
-     * Returns a vector of funding rates for a given category and symbol.
+     * Asynchronous variant of closeAllPositions()
+     */
+    [[nodiscard]] net::awaitable<void> closeAllPositionsAsync(Category category) const;
+
+    /**
+     * Returns a vector of funding rates for a given category and symbol, sorted by time ascending. The range is split
+     * by the funding interval of the instrument into partitions which are downloaded concurrently.
      * @param category i.e. Spot, Linear...
      * @param symbol e.g. BTCUSDT
      * @param startTime timestamp in ms to get funding rate from INCLUSIVE.
      * @param endTime timestamp in ms to get funding rate until INCLUSIVE.
+     * @param limit records per page, 1 to 200
      * @return vector of FundingRate structures
-     * @throws nlohmann::json::exception, std::exception
+     * @throws nlohmann::json::exception, std::invalid_argument if the limit is out of range, std::exception
      * @see https://bybit-exchange.github.io/docs/v5/market/history-fund-rate
      */
     [[nodiscard]] std::vector<FundingRate>
     getFundingRates(Category category, const std::string& symbol, int64_t startTime, int64_t endTime,
-                    std::int32_t = 200) const;
+                    std::int32_t limit = 200) const;
+
+    /**
+     * Asynchronous variant of getFundingRates()
+     */
+    [[nodiscard]] net::awaitable<std::vector<FundingRate>>
+    getFundingRatesAsync(Category category, const std::string& symbol, int64_t startTime, int64_t endTime,
+                         std::int32_t limit = 200) const;
 
     /**
      * Query for the latest price snapshot, best bid/ask price, and trading volume in the last 24 hours.
@@ -195,6 +424,11 @@ public:
      * @see https://bybit-exchange.github.io/docs/v5/market/tickers
      */
     [[nodiscard]] Tickers getTickers(Category category, const std::string& symbol) const;
+
+    /**
+     * Asynchronous variant of getTickers()
+     */
+    [[nodiscard]] net::awaitable<Tickers> getTickersAsync(Category category, const std::string& symbol) const;
 };
 }
 
@@ -0,0 +1,128 @@
+/**
+Bybit Sequence Lock
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_SEQLOCK_H
+#define INCLUDE_VK_BYBIT_SEQLOCK_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace vk::bybit {
+/**
+ * Latest value published by a single writer and read by any number of readers. The writer never waits, a reader
+ * copies the value and retries if the writer was publishing meanwhile, so it always gets a consistent snapshot.
+ * Readers only load the slot, they do not write to any shared cache line.
+ *
+ * The value is kept in atomic words, the copies are not data races.
+ */
+template<typename ValueType>
+class alignas(64) SeqLock {
+    static_assert(std::is_trivially_copyable_v<ValueType>, "SeqLock value must be trivially copyable");
+
+    static constexpr std::size_t NUM_WORDS = (sizeof(ValueType) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    /// Odd while the writer is publishing, 0 before the first value
+    std::atomic<std::uint64_t> m_sequence{0};
+    std::array<std::atomic<std::uint64_t>, NUM_WORDS> m_words{};
+
+    /// Words covering the size, at least one
+    static constexpr std::size_t numWords(const std::size_t size) {
+        return std::clamp<std::size_t>((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t), 1, NUM_WORDS);
+    }
+
+public:
+    /**
+     * Publish the value, must be called from one thread only
+     * @param value
+     */
+    void store(const ValueType& value) {
+        store(value, sizeof(ValueType));
+    }
+
+    /**
+     * Publish the beginning of the value, the rest of the slot keeps what was published before. Must be called from
+     * one thread only.
+     * @param value
+     * @param size number of bytes from the beginning of the value
+     */
+    void store(const ValueType& value, const std::size_t size) {
+        const auto count = numWords(size);
+        std::array<std::uint64_t, NUM_WORDS> words;
+        words[count - 1] = 0;
+        std::memcpy(words.data(), &value, std::min(count * sizeof(std::uint64_t), sizeof(ValueType)));
+
+        const auto sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * Read the latest value
+     * @param value
+     * @return false if no value was published yet
+     */
+    bool load(ValueType& value) const {
+        return load(value, sizeof(ValueType));
+    }
+
+    /**
+     * Read the beginning of the latest value, the rest of the value is not touched
+     * @param value
+     * @param size number of bytes from the beginning of the value
+     * @return false if no value was published yet
+     */
+    bool load(ValueType& value, const std::size_t size) const {
+        const auto count = numWords(size);
+        std::array<std::uint64_t, NUM_WORDS> words;
+
+        for (;;) {
+            const auto before = m_sequence.load(std::memory_order_acquire);
+
+            if (before == 0) {
+                return false;
+            }
+
+            if (before & 1) {
+                continue;
+            }
+
+            for (std::size_t i = 0; i < count; ++i) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (m_sequence.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+
+        /// The last word may reach beyond the end of the value
+        std::memcpy(static_cast<void*>(&value), words.data(), std::min(count * sizeof(std::uint64_t), sizeof(ValueType)));
+        return true;
+    }
+
+    /**
+     * @return number of published values
+     */
+    [[nodiscard]] std::uint64_t version() const {
+        return m_sequence.load(std::memory_order_acquire) / 2;
+    }
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_SEQLOCK_H
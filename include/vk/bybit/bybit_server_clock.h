@@ -0,0 +1,100 @@
+/**
+Bybit Server Clock
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_SERVER_CLOCK_H
+#define INCLUDE_VK_BYBIT_SERVER_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace vk::bybit {
+/**
+ * Estimates offset and drift of the local clock against the Bybit server clock. Every sample is a request sent at
+ * local time t0, stamped by the server at ts and received at local time t1. As in NTP only the samples with the
+ * smallest round trip are trusted, their offset ts - (t0 + t1) / 2 is off by at most half of the round trip.
+ * The drift is the slope of the filtered offsets over the local time.
+ */
+class ServerClock {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+public:
+    /// Number of the most recent samples kept for the estimation
+    static constexpr std::size_t MAX_SAMPLES = 16;
+
+    ServerClock();
+
+    ~ServerClock();
+
+    /**
+     * Add a time sample, all values are in us since epoch
+     * @param localSendTime local time when the request was sent
+     * @param serverTime server timestamp of the response
+     * @param localReceiveTime local time when the response was received
+     * @param isPassive true if taken from the response header of another request, e.g. Timenow with the ms resolution
+     */
+    void addSample(std::int64_t localSendTime, std::int64_t serverTime, std::int64_t localReceiveTime,
+                   bool isPassive = false) const;
+
+    /**
+     * Convert the local time to the server time
+     * @param localTime in us since epoch
+     * @return server time in us since epoch, the local time itself if not synchronized yet
+     */
+    [[nodiscard]] std::int64_t toServerTime(std::int64_t localTime) const;
+
+    /**
+     * Get the current server time estimate
+     * @return timestamp in ms
+     */
+    [[nodiscard]] std::int64_t now() const;
+
+    /**
+     * Check if at least one sample was taken since construction or reset()
+     * @return True if synchronized
+     */
+    [[nodiscard]] bool isSynchronized() const;
+
+    /**
+     * Get the age of the most recent sample
+     * @return time since the last sample, max duration if not synchronized
+     */
+    [[nodiscard]] std::chrono::microseconds timeSinceLastSample() const;
+
+    /**
+     * Get the age of the most recent active sample, i.e. one taken by a request of the server time
+     * @return time since the last active sample, max duration if there is none since construction or reset()
+     */
+    [[nodiscard]] std::chrono::microseconds timeSinceLastActiveSample() const;
+
+    /**
+     * Get the estimated offset of the server clock against the local clock at the current time
+     * @return offset in us, positive if the server clock is ahead
+     */
+    [[nodiscard]] std::int64_t offset() const;
+
+    /**
+     * Get the estimated drift of the local clock
+     * @return drift in us per second (ppm)
+     */
+    [[nodiscard]] double drift() const;
+
+    /**
+     * Get the error bound of the offset, i.e. half of the smallest round trip
+     * @return uncertainty in us
+     */
+    [[nodiscard]] std::int64_t uncertainty() const;
+
+    /**
+     * Drop all samples, e.g. when the server rejected a request timestamp
+     */
+    void reset() const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_SERVER_CLOCK_H
@@ -0,0 +1,72 @@
+/**
+Bybit shared TLS Context
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#ifndef INCLUDE_VK_BYBIT_TLS_CONTEXT_H
+#define INCLUDE_VK_BYBIT_TLS_CONTEXT_H
+
+#include <boost/asio/ssl/context.hpp>
+#include <memory>
+#include <string>
+
+namespace vk::bybit {
+/**
+ * Process-wide TLS client context shared by the REST and WebSocket sessions. It is initialised once (CA bundle is read
+ * only once) and it keeps the last TLS session per host, so reconnects can use an abbreviated handshake.
+ */
+class TLSContext {
+    struct P;
+    std::unique_ptr<P> m_p{};
+
+    TLSContext();
+
+public:
+    TLSContext(const TLSContext&) = delete;
+
+    TLSContext& operator=(const TLSContext&) = delete;
+
+    ~TLSContext();
+
+    /**
+     * Get the process-wide instance
+     * @return TLSContext instance
+     */
+    static TLSContext& instance();
+
+    /**
+     * Get the underlying SSL context, it can be shared by any number of streams
+     * @return SSL client context
+     */
+    [[nodiscard]] boost::asio::ssl::context& context() const;
+
+    /**
+     * Set the SNI hostname and attach the cached TLS session for the host (if any). Must be called before the handshake.
+     * @param ssl native handle of the SSL stream
+     * @param host e.g. api.bybit.com
+     * @return False if the SNI hostname could not be set
+     */
+    [[nodiscard]] bool prepareHandshake(SSL* ssl, const std::string& host) const;
+
+    /**
+     * Enable or disable TLS session resumption, enabled by default
+     * @param enabled
+     */
+    void setSessionResumption(bool enabled) const;
+
+    /**
+     * Check if the TLS session resumption is enabled
+     * @return True if enabled
+     */
+    [[nodiscard]] bool isSessionResumptionEnabled() const;
+
+    /**
+     * Drop all cached TLS sessions, the next handshake to every host will be a full one
+     */
+    void clearSessions() const;
+};
+} // namespace vk::bybit
+#endif // INCLUDE_VK_BYBIT_TLS_CONTEXT_H
@@ -48,6 +48,12 @@ public:
      */
     void setDataEventCallback(const onDataEvent& onDataEventCB) const;
 
+    /**
+     * Set Data Message callback receiving the message decoded in place, without the copy of the data into an Event
+     * @param onDataEventViewCB
+     */
+    void setDataEventViewCallback(const onDataEventView& onDataEventViewCB) const;
+
     /**
      * Subscribe WebSocket according to the subscriptionFilter
      * @param subscriptionFilter e.g. instrument_info.100ms.BTCUSD
@@ -55,6 +61,12 @@ public:
      */
     void subscribe(const std::string& subscriptionFilter) const;
 
+    /**
+     * Unsubscribe and subscribe the stream again, Bybit then sends a new snapshot
+     * @param subscriptionFilter subscribed stream, e.g. orderbook.50.BTCUSDT
+     */
+    void resubscribe(const std::string& subscriptionFilter) const;
+
     /**
      * Check if a stream is already subscribed
      * @param subscriptionFilter
@@ -17,6 +17,8 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 
 namespace vk::bybit {
 using onDataEvent = std::function<void(const Event &event)>;
+/// The view refers to the read buffer of the session, it is valid only during the callback
+using onDataEventView = std::function<void(const EventView &event)>;
 
 class WebSocketSession final : public std::enable_shared_from_this<WebSocketSession> {
     struct P;
@@ -32,9 +34,9 @@ public:
      * @param host
      * @param port
      * @param subscriptionFilter Must not be empty
-     * @param dataEventCB Data Message callback
+     * @param dataEventCB Data Message callback, called with the message decoded in place
      */
-    void run(const std::string &host, const std::string &port, const std::string &subscriptionFilter, const onDataEvent &dataEventCB);
+    void run(const std::string &host, const std::string &port, const std::string &subscriptionFilter, const onDataEventView &dataEventCB);
 
     /**
      * Close the session asynchronously
@@ -48,6 +50,12 @@ public:
      */
     void subscribe(const std::string &subscriptionFilter) const;
 
+    /**
+     * Unsubscribe and subscribe the stream again, Bybit then sends a new snapshot
+     * @param subscriptionFilter subscribed stream, e.g. orderbook.50.BTCUSDT
+     */
+    void resubscribe(const std::string &subscriptionFilter) const;
+
     /**
      * Check if a stream is already subscribed
      * @param subscriptionFilter
@@ -11,9 +11,15 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 
 #include "vk/utils/log_utils.h"
 #include "vk/bybit/bybit_event_models.h"
+#include "vk/bybit/bybit_order_book.h"
+#include <functional>
 #include <optional>
 
 namespace vk::bybit {
+using onEventTicker = std::function<void(const EventTicker& event)>;
+using onEventCandlestick = std::function<void(const EventCandlestick& event)>;
+using onOrderBook = std::function<void(const OrderBook& orderBook)>;
+
 class WSStreamManager {
     struct P;
     std::unique_ptr<P> m_p{};
@@ -27,16 +33,29 @@ public:
      * Check if the Ticker Stream is subscribed for a selected pair, if not then subscribe it. When force parameter
      * is true then re-subscribe if already subscribed
      * @param pair e.g BTCUSDT
+     * @param callback called on the IO thread with every update, it must not block. Replaces the previous one if set
      */
-    void subscribeTickerStream(const std::string& pair) const;
+    void subscribeTickerStream(const std::string& pair, const onEventTicker& callback = {}) const;
 
     /**
      * Check if the Candlestick Stream is subscribed for a selected pair, if not then subscribe it. When force parameter
      * is true then re-subscribe if already subscribed
      * @param pair e.g BTCUSDT
      * @param interval e.g CandleInterval::_1
+     * @param callback called on the IO thread with every update, it must not block. Replaces the previous one if set
      */
-    void subscribeCandlestickStream(const std::string& pair, CandleInterval interval) const;
+    void subscribeCandlestickStream(const std::string& pair, CandleInterval interval, const onEventCandlestick& callback = {}) const;
+
+    /**
+     * Check if the Order Book Stream is subscribed for a selected pair, if not then subscribe it. The local book is
+     * built from the snapshot and the deltas, a missed delta resubscribes the stream to get a new snapshot.
+     * @param pair e.g BTCUSDT
+     * @param depth e.g 50, see the depths of the category, at most EventOrderBook::MAX_LEVELS levels are published
+     * @param callback called on the IO thread with the full book after every update, it must not block. Replaces the
+     * previous one if set
+     * @see https://bybit-exchange.github.io/docs/v5/websocket/public/orderbook
+     */
+    void subscribeOrderBookStream(const std::string& pair, int depth, const onOrderBook& callback = {}) const;
 
     /**
      * Set time of all reading operations
@@ -57,20 +76,39 @@ public:
     void setLoggerCallback(const onLogMessage& onLogMessageCB) const;
 
     /**
-     * Try to read EventTicker structure. It will block at most Timeout time.
+     * Try to read EventTicker structure. If there is none yet, it waits for the first one at most Timeout time.
      * @param pair e.g BTCUSDT
-     * @return EventTicker structure if successful
+     * @return EventTicker structure if successful, empty immediately if the stream is not subscribed
      */
     [[nodiscard]] std::optional<EventTicker> readEventTicker(const std::string& pair) const;
 
     /**
-     * Try to read EventCandlestick structure. It will block at most Timeout time.
+     * Try to read EventCandlestick structure. If there is none yet, it waits for the first one at most Timeout time.
      * @param pair e.g BTCUSDT
      * @param interval e.g CandleInterval::_1
-     * @return EventCandlestick structure if successful
+     * @return EventCandlestick structure if successful, empty immediately if the stream is not subscribed
      */
     [[nodiscard]] std::optional<EventCandlestick>
     readEventCandlestick(const std::string& pair, CandleInterval interval) const;
+
+    /**
+     * Try to read the best levels of the order book. If it is not synchronized, it waits at most Timeout time.
+     * @param pair e.g BTCUSDT
+     * @param depth depth of the subscribed stream
+     * @param numLevels number of the best levels of each side to copy, e.g. 1 for the best bid and ask
+     * @return EventOrderBook structure if successful, empty immediately if the stream is not subscribed
+     */
+    [[nodiscard]] std::optional<EventOrderBook> readOrderBook(const std::string& pair, int depth,
+                                                              std::size_t numLevels = EventOrderBook::MAX_LEVELS) const;
+
+    /**
+     * Block until the pair gets an update (of any of its streams) newer than lastVersion, at most Timeout time.
+     * The waiting thread is woken by the update, then the values are read by readEventTicker()/readEventCandlestick().
+     * @param pair e.g BTCUSDT
+     * @param lastVersion version returned by the previous call, 0 to wait for the first update
+     * @return version of the latest update of the pair, lastVersion on timeout or if the pair is not subscribed
+     */
+    [[nodiscard]] std::uint64_t waitForUpdate(const std::string& pair, std::uint64_t lastVersion) const;
 };
 }
 
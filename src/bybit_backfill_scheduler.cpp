@@ -0,0 +1,411 @@
+/**
+Bybit Backfill Scheduler
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_backfill_scheduler.h"
+#include "vk/bybit/bybit_rest_client.h"
+#include "vk/bybit/bybit.h"
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+namespace vk::bybit {
+static constexpr std::int64_t CANDLES_PER_PAGE = 1000;
+static constexpr std::int64_t FUNDING_RATES_PER_PAGE = 200;
+static constexpr int CHECKPOINT_INTERVAL_IN_S = 1;
+static constexpr int RETRY_DELAY_IN_MS = 500;
+
+static std::int64_t steadyTimeInNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string checkpointKey(const BackfillJob& job) {
+    std::string retVal;
+    retVal.append(magic_enum::enum_name(job.type)).append(" ");
+    retVal.append(magic_enum::enum_name(job.category)).append(" ");
+    retVal.append(job.symbol).append(" ");
+    retVal.append(magic_enum::enum_name(job.interval)).append(" ");
+    retVal.append(std::to_string(job.from)).append(" ");
+    retVal.append(std::to_string(job.to));
+    return retVal;
+}
+
+struct BackfillScheduler::P {
+    struct Page {
+        std::vector<Candle> candles;
+        std::vector<FundingRate> fundingRates;
+    };
+
+    struct Job {
+        BackfillJob job;
+        std::string key;
+        std::int64_t from = 0;
+        std::int64_t windowMs = 0;
+        std::size_t numWindows = 0;
+
+        std::mutex locker;
+        std::map<std::size_t, Page> finishedPages;
+        std::size_t nextToWrite = 0;
+        std::atomic_bool failed = false;
+
+        [[nodiscard]] std::int64_t windowStart(const std::size_t window) const {
+            return from + static_cast<std::int64_t>(window) * windowMs;
+        }
+
+        [[nodiscard]] std::int64_t windowEnd(const std::size_t window) const {
+            return std::min(windowStart(window) + windowMs - 1, job.to);
+        }
+
+        /// Start of the range which is not written yet
+        [[nodiscard]] std::int64_t writtenUntil() const {
+            return nextToWrite < numWindows ? windowStart(nextToWrite) : job.to + 1;
+        }
+    };
+
+    struct Task {
+        std::size_t job = 0;
+        std::size_t window = 0;
+    };
+
+    struct WorkerQueue {
+        std::mutex locker;
+        std::deque<Task> tasks;
+    };
+
+    std::shared_ptr<RESTClient> restClient;
+    std::size_t numWorkers = 1;
+    std::filesystem::path checkpointPath;
+
+    std::map<std::string, std::int64_t> checkpoint;
+    std::deque<std::unique_ptr<Job>> jobs;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    mutable std::mutex checkpointLocker;
+    std::chrono::steady_clock::time_point lastCheckpoint{};
+    bool isCheckpointDirty = false;
+
+    std::atomic_bool stopped = false;
+    std::atomic<std::uint64_t> pages = 0;
+    std::atomic<std::uint64_t> candles = 0;
+    std::atomic<std::uint64_t> fundingRates = 0;
+    std::atomic<std::uint64_t> completedJobs = 0;
+    std::atomic<std::uint64_t> failedJobs = 0;
+    /// ns of the steady clock, 0 when not set
+    std::atomic<std::int64_t> startTime = 0;
+    std::atomic<std::int64_t> endTime = 0;
+
+    onBackfillCandles candleWriter;
+    onBackfillFundingRates fundingRateWriter;
+
+    void loadCheckpoint() {
+        std::ifstream ifs(checkpointPath);
+        std::string line;
+
+        while (std::getline(ifs, line)) {
+            /// The key has 6 fields, the written time is the last one
+            if (const auto pos = line.find_last_of(' '); pos != std::string::npos) {
+                checkpoint[line.substr(0, pos)] = std::stoll(line.substr(pos + 1));
+            }
+        }
+    }
+
+    /**
+     * Write the checkpoint to a temporary file and rename it, so a crash never leaves a truncated checkpoint
+     * @throws std::runtime_error if the file could not be written, the checkpoint stays dirty
+     */
+    void saveCheckpoint(const bool force) {
+        if (checkpointPath.empty()) {
+            return;
+        }
+
+        std::lock_guard lk(checkpointLocker);
+        const auto now = std::chrono::steady_clock::now();
+
+        if (!isCheckpointDirty || (!force && now - lastCheckpoint < std::chrono::seconds(CHECKPOINT_INTERVAL_IN_S))) {
+            return;
+        }
+
+        std::ostringstream oss;
+
+        for (const auto& [key, writtenUntil]: checkpoint) {
+            oss << key << ' ' << writtenUntil << '\n';
+        }
+
+        auto tmpPath = checkpointPath;
+        tmpPath += ".tmp";
+        {
+            std::ofstream ofs(tmpPath, std::ios::trunc);
+            ofs << oss.str();
+
+            if (!ofs.flush()) {
+                throw std::runtime_error("Could not write backfill checkpoint: " + tmpPath.string());
+            }
+        }
+
+        std::filesystem::rename(tmpPath, checkpointPath);
+        lastCheckpoint = now;
+        isCheckpointDirty = false;
+    }
+
+    /**
+     * Own tasks are taken from the front to keep the chronological order, stolen ones from the back of the victim
+     */
+    std::optional<Task> nextTask(const std::size_t worker) const {
+        {
+            auto& queue = *queues[worker];
+            std::lock_guard lk(queue.locker);
+
+            if (!queue.tasks.empty()) {
+                const auto task = queue.tasks.front();
+                queue.tasks.pop_front();
+                return task;
+            }
+        }
+
+        for (std::size_t i = 1; i < queues.size(); ++i) {
+            auto& victim = *queues[(worker + i) % queues.size()];
+            std::lock_guard lk(victim.locker);
+
+            if (!victim.tasks.empty()) {
+                const auto task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return task;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    Page fetch(const Job& job, const std::size_t window) {
+        const auto& j = job.job;
+        const auto startTime = job.windowStart(window);
+        const auto endTime = job.windowEnd(window);
+        Page page;
+
+        if (j.type == BackfillType::Candles) {
+            page.candles = restClient->downloadHistoricalPrices(j.category, j.symbol, j.interval, startTime, endTime, {}, 1);
+        } else {
+            page.fundingRates = restClient->getFundingRates(j.category, j.symbol, startTime, endTime);
+            std::erase_if(page.fundingRates, [startTime, endTime](const FundingRate& fr) {
+                return fr.fundingRateTimestamp < startTime || fr.fundingRateTimestamp > endTime;
+            });
+        }
+
+        ++pages;
+        return page;
+    }
+
+    /**
+     * Write all pages following the already written ones, pages of one job are written under its lock
+     */
+    void write(Job& job, const std::size_t window, Page page) {
+        std::lock_guard lk(job.locker);
+        job.finishedPages.emplace(window, std::move(page));
+
+        for (auto it = job.finishedPages.find(job.nextToWrite); it != job.finishedPages.end(); it = job.finishedPages.find(job.nextToWrite)) {
+            if (job.job.type == BackfillType::Candles) {
+                candles += it->second.candles.size();
+
+                if (candleWriter && !it->second.candles.empty()) {
+                    candleWriter(job.job, it->second.candles);
+                }
+            } else {
+                fundingRates += it->second.fundingRates.size();
+
+                if (fundingRateWriter && !it->second.fundingRates.empty()) {
+                    fundingRateWriter(job.job, it->second.fundingRates);
+                }
+            }
+
+            job.finishedPages.erase(it);
+            ++job.nextToWrite;
+        }
+
+        if (job.nextToWrite == job.numWindows) {
+            ++completedJobs;
+        }
+
+        {
+            std::lock_guard clk(checkpointLocker);
+            checkpoint[job.key] = job.writtenUntil();
+            isCheckpointDirty = true;
+        }
+    }
+
+    void runWorker(const std::size_t worker) {
+        while (!stopped) {
+            const auto task = nextTask(worker);
+
+            if (!task) {
+                return;
+            }
+
+            auto& job = *jobs[task->job];
+
+            if (job.failed) {
+                continue;
+            }
+
+            for (int attempt = 1;; ++attempt) {
+                try {
+                    write(job, task->window, fetch(job, task->window));
+                    break;
+                } catch (const std::exception&) {
+                    if (attempt == MAX_PAGE_ATTEMPTS || stopped) {
+                        if (!job.failed.exchange(true)) {
+                            ++failedJobs;
+                        }
+
+                        break;
+                    }
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(RETRY_DELAY_IN_MS * attempt));
+                }
+            }
+
+            try {
+                saveCheckpoint(false);
+            } catch (const std::exception&) {
+                /// The checkpoint stays dirty, the next page or the end of the run tries again
+            }
+        }
+    }
+};
+
+BackfillScheduler::BackfillScheduler(std::shared_ptr<RESTClient> restClient, const std::size_t numWorkers,
+                                     const std::filesystem::path& checkpointPath) : m_p(std::make_unique<P>()) {
+    m_p->restClient = std::move(restClient);
+    m_p->numWorkers = std::max<std::size_t>(1, numWorkers);
+    m_p->checkpointPath = checkpointPath;
+
+    if (!checkpointPath.empty() && std::filesystem::exists(checkpointPath)) {
+        m_p->loadCheckpoint();
+    }
+}
+
+BackfillScheduler::~BackfillScheduler() = default;
+
+void BackfillScheduler::addJob(const BackfillJob& job) const {
+    if (job.from > job.to) {
+        throw std::invalid_argument("Invalid backfill range: " + job.symbol);
+    }
+
+    auto state = std::make_unique<P::Job>();
+    state->job = job;
+    state->key = checkpointKey(job);
+    state->from = job.from;
+
+    if (const auto it = m_p->checkpoint.find(state->key); it != m_p->checkpoint.end()) {
+        state->from = std::max(job.from, it->second);
+    }
+
+    if (state->from > job.to) {
+        return;
+    }
+
+    const auto stepMs = job.type == BackfillType::Candles
+                            ? Bybit::numberOfMsForCandleInterval(job.interval)
+                            : static_cast<std::int64_t>(job.fundingInterval) * 60000;
+
+    if (stepMs <= 0) {
+        throw std::invalid_argument("Invalid backfill interval: " + job.symbol);
+    }
+
+    state->windowMs = stepMs * (job.type == BackfillType::Candles ? CANDLES_PER_PAGE : FUNDING_RATES_PER_PAGE);
+    state->numWindows = static_cast<std::size_t>((job.to - state->from) / state->windowMs + 1);
+    m_p->jobs.push_back(std::move(state));
+}
+
+void BackfillScheduler::run(const onBackfillCandles& candleWriter, const onBackfillFundingRates& fundingRateWriter) const {
+    m_p->candleWriter = candleWriter;
+    m_p->fundingRateWriter = fundingRateWriter;
+    m_p->stopped = false;
+    m_p->pages = 0;
+    m_p->candles = 0;
+    m_p->fundingRates = 0;
+    m_p->completedJobs = 0;
+    m_p->failedJobs = 0;
+
+    m_p->queues.clear();
+
+    for (std::size_t i = 0; i < m_p->numWorkers; ++i) {
+        m_p->queues.push_back(std::make_unique<P::WorkerQueue>());
+    }
+
+    /// Deal the pages round-robin: the first page of every job, then the second page of every job...
+    std::size_t maxWindows = 0;
+
+    for (const auto& job: m_p->jobs) {
+        maxWindows = std::max(maxWindows, job->numWindows);
+        /// A job failed or stopped in the previous run is retried from its first unwritten page
+        job->failed = false;
+        job->finishedPages.clear();
+    }
+
+    std::size_t nextQueue = 0;
+
+    for (std::size_t window = 0; window < maxWindows; ++window) {
+        for (std::size_t job = 0; job < m_p->jobs.size(); ++job) {
+            if (window < m_p->jobs[job]->numWindows && window >= m_p->jobs[job]->nextToWrite) {
+                m_p->queues[nextQueue]->tasks.push_back({job, window});
+                nextQueue = (nextQueue + 1) % m_p->numWorkers;
+            }
+        }
+    }
+
+    m_p->startTime = steadyTimeInNs();
+    m_p->endTime = 0;
+
+    std::vector<std::thread> workers;
+
+    for (std::size_t i = 0; i < m_p->numWorkers; ++i) {
+        workers.emplace_back([this, i] { m_p->runWorker(i); });
+    }
+
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    m_p->endTime = steadyTimeInNs();
+    m_p->saveCheckpoint(true);
+}
+
+void BackfillScheduler::stop() const {
+    m_p->stopped = true;
+}
+
+BackfillStats BackfillScheduler::getStats() const {
+    BackfillStats retVal;
+    retVal.pages = m_p->pages;
+    retVal.candles = m_p->candles;
+    retVal.fundingRates = m_p->fundingRates;
+    retVal.completedJobs = m_p->completedJobs;
+    retVal.failedJobs = m_p->failedJobs;
+
+    const std::int64_t startTime = m_p->startTime;
+
+    if (startTime == 0) {
+        return retVal;
+    }
+
+    const std::int64_t endTime = m_p->endTime;
+    const auto elapsed = std::chrono::nanoseconds((endTime == 0 ? steadyTimeInNs() : endTime) - startTime);
+    retVal.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+
+    if (const auto seconds = std::chrono::duration<double>(elapsed).count(); seconds > 0.0) {
+        retVal.pagesPerSecond = static_cast<double>(retVal.pages) / seconds;
+        retVal.candlesPerSecond = static_cast<double>(retVal.candles) / seconds;
+    }
+
+    return retVal;
+}
+} // namespace vk::bybit
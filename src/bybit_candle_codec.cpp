@@ -0,0 +1,433 @@
+/**
+Bybit Candle Codec
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_candle_codec.h"
+#include <array>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace vk::bybit {
+static constexpr std::uint32_t MAGIC = 0x5a435956; // "VYCZ"
+/// Zero bytes after every block, the reader loads 8 bytes at a time and checks the bounds once per value
+static constexpr std::size_t BLOCK_PADDING = 16;
+
+static constexpr std::uint64_t lowBits(const int numBits) {
+    return numBits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << numBits) - 1;
+}
+
+static constexpr std::uint64_t toBigEndian(const std::uint64_t value) {
+    if constexpr (std::endian::native == std::endian::big) {
+        return value;
+    } else {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap64(value);
+#else
+        std::uint64_t retVal = 0;
+
+        for (int i = 0; i < 8; ++i) {
+            retVal = retVal << 8 | (value >> (i * 8) & 0xff);
+        }
+
+        return retVal;
+#endif
+    }
+}
+
+static std::uint64_t zigzag(const std::int64_t value) {
+    return static_cast<std::uint64_t>(value) << 1 ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+static std::int64_t unzigzag(const std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+/// Damaged data must not overflow, the arithmetic of times wraps around
+static std::int64_t wrappingAdd(const std::int64_t lhs, const std::int64_t rhs) {
+    return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) + static_cast<std::uint64_t>(rhs));
+}
+
+static std::int64_t wrappingSub(const std::int64_t lhs, const std::int64_t rhs) {
+    return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) - static_cast<std::uint64_t>(rhs));
+}
+
+template<typename ValueType>
+static void appendRaw(std::string& out, const ValueType value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+}
+
+template<typename ValueType>
+static ValueType readRaw(std::string_view& data) {
+    ValueType retVal{};
+
+    if (data.size() < sizeof(ValueType)) {
+        throw std::runtime_error("Candle data is truncated");
+    }
+
+    std::memcpy(&retVal, data.data(), sizeof(ValueType));
+    data.remove_prefix(sizeof(ValueType));
+    return retVal;
+}
+
+/**
+ * Writes bits MSB first
+ */
+class BitWriter {
+    std::string& m_out;
+    std::uint64_t m_buffer = 0;
+    int m_numBits = 0;
+
+public:
+    explicit BitWriter(std::string& out) : m_out(out) {}
+
+    void write(const std::uint64_t value, const int numBits) {
+        if (numBits > 32) {
+            write(value >> 32, numBits - 32);
+            write(value, 32);
+            return;
+        }
+
+        m_buffer = m_buffer << numBits | (value & lowBits(numBits));
+        m_numBits += numBits;
+
+        while (m_numBits >= 8) {
+            m_numBits -= 8;
+            m_out.push_back(static_cast<char>(m_buffer >> m_numBits));
+        }
+
+        m_buffer &= lowBits(m_numBits);
+    }
+
+    void flush() {
+        if (m_numBits > 0) {
+            write(0, 8 - m_numBits);
+        }
+    }
+};
+
+/**
+ * Reads bits MSB first, a read is one unaligned 8 byte load
+ */
+class BitReader {
+    const unsigned char* m_data;
+    std::size_t m_position = 0;
+
+public:
+    explicit BitReader(const char* data) : m_data(reinterpret_cast<const unsigned char*>(data)) {}
+
+    /**
+     * @param numBits 1 to 57
+     */
+    std::uint64_t read(const int numBits) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, m_data + (m_position >> 3), sizeof(word));
+        word = toBigEndian(word) << (m_position & 7);
+        m_position += static_cast<std::size_t>(numBits);
+        return word >> (64 - numBits);
+    }
+
+    /**
+     * @param numBits 1 to 64
+     */
+    std::uint64_t readLong(const int numBits) {
+        if (numBits > 32) {
+            const auto high = read(numBits - 32);
+            return high << 32 | read(32);
+        }
+
+        return read(numBits);
+    }
+
+    /**
+     * Next bits without consuming them, at least 57 of them are valid
+     */
+    [[nodiscard]] std::uint64_t peek() const {
+        std::uint64_t word = 0;
+        std::memcpy(&word, m_data + (m_position >> 3), sizeof(word));
+        return toBigEndian(word) << (m_position & 7);
+    }
+
+    /// Next bits without consuming them, used to decode the prefix codes at once
+    [[nodiscard]] std::uint64_t peek(const int numBits) const {
+        return peek() >> (64 - numBits);
+    }
+
+    void skip(const int numBits) {
+        m_position += static_cast<std::size_t>(numBits);
+    }
+
+    [[nodiscard]] std::size_t position() const {
+        return m_position;
+    }
+};
+
+/**
+ * Gorilla XOR state of one column
+ */
+struct XorState {
+    int leading = -1;
+    int trailing = 0;
+};
+
+static void encodeXor(BitWriter& writer, XorState& state, const std::uint64_t value, const std::uint64_t predicted) {
+    const auto x = value ^ predicted;
+
+    if (x == 0) {
+        writer.write(0, 1);
+        return;
+    }
+
+    const auto leading = std::min(std::countl_zero(x), 31);
+    const auto trailing = std::countr_zero(x);
+
+    if (state.leading >= 0 && leading >= state.leading && trailing >= state.trailing) {
+        writer.write(0b10, 2);
+        writer.write(x >> state.trailing, 64 - state.leading - state.trailing);
+        return;
+    }
+
+    const auto length = 64 - leading - trailing;
+    writer.write(0b11, 2);
+    writer.write(static_cast<std::uint64_t>(leading), 5);
+    writer.write(static_cast<std::uint64_t>(length - 1), 6);
+    writer.write(x >> trailing, length);
+    state = {leading, trailing};
+}
+
+/**
+ * Decode one value, short values are decoded from a single load of the reader
+ */
+static std::uint64_t decodeXor(BitReader& reader, XorState& state, const std::uint64_t predicted) {
+    const auto word = reader.peek();
+
+    if (word >> 63 == 0) {
+        reader.skip(1);
+        return predicted;
+    }
+
+    int headerSize = 2;
+
+    if ((word >> 62 & 1) == 1) {
+        const auto header = word >> 51 & 0x7ff;
+        state.leading = static_cast<int>(header >> 6);
+        state.trailing = 64 - state.leading - static_cast<int>(header & 0x3f) - 1;
+        headerSize = 13;
+
+        if (state.trailing < 0) {
+            throw std::runtime_error("Candle data is damaged");
+        }
+    } else if (state.leading < 0) {
+        throw std::runtime_error("Candle data is damaged");
+    }
+
+    const auto length = 64 - state.leading - state.trailing;
+
+    if (headerSize + length <= 57) {
+        reader.skip(headerSize + length);
+        return predicted ^ (word << headerSize) >> (64 - length) << state.trailing;
+    }
+
+    reader.skip(headerSize);
+    return predicted ^ reader.readLong(length) << state.trailing;
+}
+
+static void encodeTimes(BitWriter& writer, const Candle* candles, const std::size_t count) {
+    writer.write(static_cast<std::uint64_t>(candles[0].startTime), 64);
+
+    if (count < 2) {
+        return;
+    }
+
+    auto delta = wrappingSub(candles[1].startTime, candles[0].startTime);
+    writer.write(zigzag(delta), 64);
+
+    for (std::size_t i = 2; i < count; ++i) {
+        const auto nextDelta = wrappingSub(candles[i].startTime, candles[i - 1].startTime);
+        const auto z = zigzag(wrappingSub(nextDelta, delta));
+        delta = nextDelta;
+
+        if (z == 0) {
+            writer.write(0, 1);
+        } else if (z < (1 << 7)) {
+            writer.write(0b10, 2);
+            writer.write(z, 7);
+        } else if (z < (1 << 12)) {
+            writer.write(0b110, 3);
+            writer.write(z, 12);
+        } else if (z < (1 << 20)) {
+            writer.write(0b1110, 4);
+            writer.write(z, 20);
+        } else {
+            writer.write(0b1111, 4);
+            writer.write(z, 64);
+        }
+    }
+}
+
+static void decodeTimes(BitReader& reader, Candle* candles, const std::size_t count, const std::size_t limit) {
+    candles[0].startTime = static_cast<std::int64_t>(reader.readLong(64));
+
+    if (count < 2) {
+        return;
+    }
+
+    auto delta = unzigzag(reader.readLong(64));
+    candles[1].startTime = wrappingAdd(candles[0].startTime, delta);
+
+    if (reader.position() > limit) {
+        throw std::runtime_error("Candle data is damaged");
+    }
+
+    for (std::size_t i = 2; i < count; ++i) {
+        /// The prefix code is at most 4 bits, one peek selects the branch
+        switch (const auto prefix = reader.peek(4); prefix) {
+        case 0b0000: case 0b0001: case 0b0010: case 0b0011:
+        case 0b0100: case 0b0101: case 0b0110: case 0b0111:
+            reader.skip(1);
+            break;
+        case 0b1000: case 0b1001: case 0b1010: case 0b1011:
+            reader.skip(2);
+            delta = wrappingAdd(delta, unzigzag(reader.read(7)));
+            break;
+        case 0b1100: case 0b1101:
+            reader.skip(3);
+            delta = wrappingAdd(delta, unzigzag(reader.read(12)));
+            break;
+        case 0b1110:
+            reader.skip(4);
+            delta = wrappingAdd(delta, unzigzag(reader.read(20)));
+            break;
+        default:
+            reader.skip(4);
+            delta = wrappingAdd(delta, unzigzag(reader.readLong(64)));
+            break;
+        }
+
+        candles[i].startTime = wrappingAdd(candles[i - 1].startTime, delta);
+
+        if (reader.position() > limit) {
+            throw std::runtime_error("Candle data is damaged");
+        }
+    }
+}
+
+/// Close first, the open price is predicted from it
+static constexpr std::array<double Candle::*, 6> COLUMNS = {&Candle::close, &Candle::open, &Candle::high, &Candle::low, &Candle::volume, &Candle::turnover};
+
+/**
+ * @return bits of the values stored in full width: the first start time, the first delta and the first value of every
+ * column
+ */
+static std::size_t fixedBlockBits(const std::size_t count) {
+    return (count < 2 ? 1 : 2) * 64 + COLUMNS.size() * 64;
+}
+
+template<std::size_t Column>
+static void encodeColumn(BitWriter& writer, const Candle* candles, const std::size_t count) {
+    constexpr auto column = COLUMNS[Column];
+    XorState state;
+    writer.write(std::bit_cast<std::uint64_t>(candles[0].*column), 64);
+
+    for (std::size_t i = 1; i < count; ++i) {
+        const auto predicted = column == &Candle::open ? candles[i - 1].close : candles[i - 1].*column;
+        encodeXor(writer, state, std::bit_cast<std::uint64_t>(candles[i].*column), std::bit_cast<std::uint64_t>(predicted));
+    }
+}
+
+template<std::size_t Column>
+static void decodeColumn(BitReader& reader, Candle* candles, const std::size_t count, const std::size_t limit) {
+    constexpr auto column = COLUMNS[Column];
+    XorState state;
+    candles[0].*column = std::bit_cast<double>(reader.readLong(64));
+
+    if (reader.position() > limit) {
+        throw std::runtime_error("Candle data is damaged");
+    }
+
+    for (std::size_t i = 1; i < count; ++i) {
+        const auto predicted = column == &Candle::open ? candles[i - 1].close : candles[i - 1].*column;
+        candles[i].*column = std::bit_cast<double>(decodeXor(reader, state, std::bit_cast<std::uint64_t>(predicted)));
+
+        if (reader.position() > limit) {
+            throw std::runtime_error("Candle data is damaged");
+        }
+    }
+}
+
+std::string CandleCodec::encode(const std::vector<Candle>& candles) {
+    std::string retVal;
+    appendRaw(retVal, MAGIC);
+    appendRaw(retVal, VERSION);
+    appendRaw(retVal, static_cast<std::uint64_t>(candles.size()));
+
+    for (std::size_t first = 0; first < candles.size(); first += BLOCK_SIZE) {
+        const auto count = std::min(BLOCK_SIZE, candles.size() - first);
+        const auto* block = candles.data() + first;
+
+        std::string payload;
+        BitWriter writer(payload);
+        encodeTimes(writer, block, count);
+
+        [&]<std::size_t... Columns>(std::index_sequence<Columns...>) {
+            (encodeColumn<Columns>(writer, block, count), ...);
+        }(std::make_index_sequence<COLUMNS.size()>());
+
+        writer.flush();
+        payload.append(BLOCK_PADDING, '\0');
+
+        appendRaw(retVal, static_cast<std::uint32_t>(count));
+        appendRaw(retVal, static_cast<std::uint32_t>(payload.size()));
+        retVal.append(payload);
+    }
+
+    return retVal;
+}
+
+std::vector<Candle> CandleCodec::decode(std::string_view data) {
+    if (readRaw<std::uint32_t>(data) != MAGIC || readRaw<std::uint32_t>(data) != VERSION) {
+        throw std::runtime_error("Unsupported candle data");
+    }
+
+    const auto numCandles = readRaw<std::uint64_t>(data);
+
+    if (numCandles > data.size() * 8) {
+        throw std::runtime_error("Candle data is damaged");
+    }
+
+    std::vector<Candle> retVal(static_cast<std::size_t>(numCandles));
+
+    for (std::size_t first = 0; first < retVal.size();) {
+        const auto count = readRaw<std::uint32_t>(data);
+        const auto payloadSize = readRaw<std::uint32_t>(data);
+
+        if (count == 0 || count > retVal.size() - first || payloadSize < BLOCK_PADDING || payloadSize > data.size()) {
+            throw std::runtime_error("Candle data is damaged");
+        }
+
+        /// Reads may run into the padding before the bounds are checked, but never past it
+        const auto limit = (payloadSize - BLOCK_PADDING) * 8;
+
+        /// The first values of the block are read before any check, they must fit into the payload
+        if (limit < fixedBlockBits(count)) {
+            throw std::runtime_error("Candle data is damaged");
+        }
+        auto* block = retVal.data() + first;
+        BitReader reader(data.data());
+        decodeTimes(reader, block, count, limit);
+
+        [&]<std::size_t... Columns>(std::index_sequence<Columns...>) {
+            (decodeColumn<Columns>(reader, block, count, limit), ...);
+        }(std::make_index_sequence<COLUMNS.size()>());
+
+        data.remove_prefix(payloadSize);
+        first += count;
+    }
+
+    return retVal;
+}
+} // namespace vk::bybit
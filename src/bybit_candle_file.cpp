@@ -0,0 +1,307 @@
+/**
+Bybit Candle File
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_candle_file.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <mutex>
+
+namespace vk::bybit {
+namespace bip = boost::interprocess;
+
+static constexpr std::uint32_t MAGIC = 0x43594256; // "VBYC"
+static constexpr std::size_t NUM_COLUMNS = 7;
+static constexpr std::array<const char*, NUM_COLUMNS> COLUMN_NAMES = {"startTime", "open", "high", "low", "close", "volume", "turnover"};
+static constexpr std::size_t VALUE_SIZE = sizeof(std::int64_t);
+
+static_assert(sizeof(double) == VALUE_SIZE);
+
+struct Header {
+    std::uint32_t magic = MAGIC;
+    std::uint32_t version = CandleFile::VERSION;
+    /// Number of committed candles, the commit point of appends
+    std::uint64_t count = 0;
+};
+
+static std::size_t numIndexEntries(const std::size_t count) {
+    return (count + CandleFile::INDEX_STRIDE - 1) / CandleFile::INDEX_STRIDE;
+}
+
+std::size_t CandleColumns::size() const {
+    return startTime.size();
+}
+
+bool CandleColumns::empty() const {
+    return startTime.empty();
+}
+
+Candle CandleColumns::candle(const std::size_t index) const {
+    Candle retVal;
+    retVal.startTime = startTime[index];
+    retVal.open = open[index];
+    retVal.high = high[index];
+    retVal.low = low[index];
+    retVal.close = close[index];
+    retVal.volume = volume[index];
+    retVal.turnover = turnover[index];
+    return retVal;
+}
+
+CandleColumns CandleColumns::subrange(const std::size_t offset, const std::size_t count) const {
+    return {startTime.subspan(offset, count), open.subspan(offset, count), high.subspan(offset, count), low.subspan(offset, count),
+            close.subspan(offset, count), volume.subspan(offset, count), turnover.subspan(offset, count), mapping};
+}
+
+struct CandleFile::P {
+    /// Regions of one committed count, shared by all views created from it
+    struct Mapping {
+        std::size_t count = 0;
+        std::array<bip::mapped_region, NUM_COLUMNS> columns;
+        bip::mapped_region index;
+
+        template<typename ValueType>
+        [[nodiscard]] std::span<const ValueType> column(const std::size_t column) const {
+            return {static_cast<const ValueType*>(columns[column].get_address()), count};
+        }
+
+        [[nodiscard]] std::span<const std::int64_t> timeIndex() const {
+            return {static_cast<const std::int64_t*>(index.get_address()), numIndexEntries(count)};
+        }
+    };
+
+    std::filesystem::path directory;
+    CandleFileMode mode = CandleFileMode::ReadOnly;
+    bip::mapped_region header;
+
+    mutable std::mutex locker;
+    mutable std::shared_ptr<const Mapping> mapping;
+
+    std::array<std::ofstream, NUM_COLUMNS> columnFiles;
+    std::ofstream indexFile;
+    std::int64_t lastStartTime = std::numeric_limits<std::int64_t>::min();
+
+    [[nodiscard]] std::filesystem::path columnPath(const std::size_t column) const {
+        return directory / (std::string(COLUMN_NAMES[column]) + ".col");
+    }
+
+    [[nodiscard]] std::filesystem::path indexPath() const {
+        return directory / "index.col";
+    }
+
+    [[nodiscard]] std::filesystem::path headerPath() const {
+        return directory / "header";
+    }
+
+    [[nodiscard]] std::atomic_ref<std::uint64_t> committedCount() const {
+        return std::atomic_ref(static_cast<Header*>(header.get_address())->count);
+    }
+
+    void openHeader() {
+        if (mode == CandleFileMode::ReadWrite && !std::filesystem::exists(headerPath())) {
+            std::filesystem::create_directories(directory);
+            const Header initial;
+            std::ofstream ofs(headerPath(), std::ios::binary);
+            ofs.write(reinterpret_cast<const char*>(&initial), sizeof(initial));
+
+            if (!ofs.flush()) {
+                throw std::runtime_error("Could not create candle file: " + directory.string());
+            }
+        }
+
+        if (!std::filesystem::exists(headerPath()) || std::filesystem::file_size(headerPath()) != sizeof(Header)) {
+            throw std::runtime_error("Invalid candle file: " + directory.string());
+        }
+
+        const auto access = mode == CandleFileMode::ReadWrite ? bip::read_write : bip::read_only;
+        header = bip::mapped_region(bip::file_mapping(headerPath().c_str(), access), access, 0, sizeof(Header));
+
+        if (const auto* h = static_cast<const Header*>(header.get_address()); h->magic != MAGIC || h->version != VERSION) {
+            throw std::runtime_error("Unsupported candle file: " + directory.string());
+        }
+    }
+
+    /**
+     * Cut off the data appended after the last commit and open the files for appending, the files opened before are
+     * closed first
+     */
+    void openForAppend() {
+        const auto count = static_cast<std::size_t>(committedCount().load());
+
+        for (auto& file: columnFiles) {
+            file.close();
+            file.clear();
+        }
+
+        indexFile.close();
+        indexFile.clear();
+
+        for (std::size_t i = 0; i < NUM_COLUMNS; ++i) {
+            std::ofstream(columnPath(i), std::ios::binary | std::ios::app).close();
+            std::filesystem::resize_file(columnPath(i), count * VALUE_SIZE);
+            columnFiles[i].open(columnPath(i), std::ios::binary | std::ios::app);
+        }
+
+        std::ofstream(indexPath(), std::ios::binary | std::ios::app).close();
+        std::filesystem::resize_file(indexPath(), numIndexEntries(count) * VALUE_SIZE);
+        indexFile.open(indexPath(), std::ios::binary | std::ios::app);
+
+        if (count > 0) {
+            std::ifstream ifs(columnPath(0), std::ios::binary);
+            ifs.seekg(static_cast<std::streamoff>((count - 1) * VALUE_SIZE));
+            ifs.read(reinterpret_cast<char*>(&lastStartTime), VALUE_SIZE);
+        }
+    }
+
+    /**
+     * @return mapping of the committed candles, the columns are mapped again only when the count changed
+     */
+    [[nodiscard]] std::shared_ptr<const Mapping> map() const {
+        const auto count = static_cast<std::size_t>(committedCount().load(std::memory_order_acquire));
+
+        std::lock_guard lk(locker);
+
+        if (mapping && mapping->count == count) {
+            return mapping;
+        }
+
+        auto retVal = std::make_shared<Mapping>();
+        retVal->count = count;
+
+        if (count > 0) {
+            for (std::size_t i = 0; i < NUM_COLUMNS; ++i) {
+                retVal->columns[i] = bip::mapped_region(bip::file_mapping(columnPath(i).c_str(), bip::read_only), bip::read_only, 0, count * VALUE_SIZE);
+            }
+
+            retVal->index = bip::mapped_region(bip::file_mapping(indexPath().c_str(), bip::read_only), bip::read_only, 0, numIndexEntries(count) * VALUE_SIZE);
+        }
+
+        mapping = retVal;
+        return retVal;
+    }
+
+    [[nodiscard]] static CandleColumns view(const std::shared_ptr<const Mapping>& mapping) {
+        return {mapping->column<std::int64_t>(0), mapping->column<double>(1), mapping->column<double>(2), mapping->column<double>(3),
+                mapping->column<double>(4), mapping->column<double>(5), mapping->column<double>(6), mapping};
+    }
+
+    /**
+     * Find the position of the time, the time index narrows the search to one stride of the startTime column
+     * @param time
+     * @param upper position after the candles starting at the time if true, before them otherwise
+     */
+    [[nodiscard]] static std::size_t position(const Mapping& mapping, const std::int64_t time, const bool upper) {
+        const auto index = mapping.timeIndex();
+        const auto startTime = mapping.column<std::int64_t>(0);
+        const auto entry = static_cast<std::size_t>((upper ? std::ranges::upper_bound(index, time) : std::ranges::lower_bound(index, time)) - index.begin());
+        const auto first = entry > 0 ? (entry - 1) * INDEX_STRIDE : 0;
+        const auto last = std::min(entry * INDEX_STRIDE, mapping.count);
+        const auto block = startTime.subspan(first, last - first);
+        return first + static_cast<std::size_t>((upper ? std::ranges::upper_bound(block, time) : std::ranges::lower_bound(block, time)) - block.begin());
+    }
+};
+
+CandleFile::CandleFile(const std::filesystem::path& directory, const CandleFileMode mode) : m_p(std::make_unique<P>()) {
+    m_p->directory = directory;
+    m_p->mode = mode;
+    m_p->openHeader();
+
+    if (mode == CandleFileMode::ReadWrite) {
+        m_p->openForAppend();
+    }
+}
+
+CandleFile::~CandleFile() = default;
+
+std::size_t CandleFile::append(const std::vector<Candle>& candles) const {
+    if (m_p->mode != CandleFileMode::ReadWrite) {
+        throw std::runtime_error("Candle file is opened read only: " + m_p->directory.string());
+    }
+
+    std::lock_guard lk(m_p->locker);
+    const auto count = static_cast<std::size_t>(m_p->committedCount().load());
+    std::array<std::vector<char>, NUM_COLUMNS> columns;
+    std::vector<std::int64_t> index;
+    std::size_t retVal = 0;
+    /// Advanced only by the commit, a failed append leaves the file as it was
+    auto lastStartTime = m_p->lastStartTime;
+
+    for (const auto& candle: candles) {
+        if (candle.startTime <= lastStartTime) {
+            continue;
+        }
+
+        if ((count + retVal) % INDEX_STRIDE == 0) {
+            index.push_back(candle.startTime);
+        }
+
+        const std::array<const void*, NUM_COLUMNS> values = {&candle.startTime, &candle.open, &candle.high, &candle.low,
+                                                             &candle.close, &candle.volume, &candle.turnover};
+
+        for (std::size_t i = 0; i < NUM_COLUMNS; ++i) {
+            const auto* bytes = static_cast<const char*>(values[i]);
+            columns[i].insert(columns[i].end(), bytes, bytes + VALUE_SIZE);
+        }
+
+        lastStartTime = candle.startTime;
+        ++retVal;
+    }
+
+    if (retVal == 0) {
+        return 0;
+    }
+
+    for (std::size_t i = 0; i < NUM_COLUMNS; ++i) {
+        m_p->columnFiles[i].write(columns[i].data(), static_cast<std::streamsize>(columns[i].size()));
+        m_p->columnFiles[i].flush();
+    }
+
+    m_p->indexFile.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * VALUE_SIZE));
+    m_p->indexFile.flush();
+
+    if (!m_p->indexFile || std::ranges::any_of(m_p->columnFiles, [](const std::ofstream& file) { return !file; })) {
+        /// The columns may be written partially, they are cut back to the committed count so they stay aligned
+        try {
+            m_p->openForAppend();
+        } catch (const std::exception&) {
+            /// The files stay closed, the next append fails as well
+        }
+
+        throw std::runtime_error("Could not append to candle file: " + m_p->directory.string());
+    }
+
+    /// Commit, the readers see the new candles from now on
+    m_p->committedCount().store(count + retVal, std::memory_order_release);
+    m_p->lastStartTime = lastStartTime;
+    return retVal;
+}
+
+std::size_t CandleFile::size() const {
+    return static_cast<std::size_t>(m_p->committedCount().load(std::memory_order_acquire));
+}
+
+CandleColumns CandleFile::columns() const {
+    return P::view(m_p->map());
+}
+
+CandleColumns CandleFile::find(const std::int64_t from, const std::int64_t to) const {
+    const auto mapping = m_p->map();
+
+    if (mapping->count == 0 || from > to) {
+        return {};
+    }
+
+    const auto first = P::position(*mapping, from, false);
+    const auto last = P::position(*mapping, to, true);
+    return P::view(mapping).subrange(first, last > first ? last - first : 0);
+}
+} // namespace vk::bybit
@@ -0,0 +1,493 @@
+/**
+Bybit Candle Store
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_candle_store.h"
+#include "vk/bybit/bybit_candle_codec.h"
+#include "vk/bybit/bybit_rest_client.h"
+#include "vk/bybit/bybit.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace vk::bybit {
+/// startTime and six doubles
+static constexpr std::size_t CANDLE_RECORD_SIZE = sizeof(std::int64_t) + 6 * sizeof(double);
+
+static std::int64_t localTimeInMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Monthly candles have no fixed length, the distance of their start times says nothing about holes
+ */
+static bool hasFixedLength(const CandleInterval interval) {
+    return interval != CandleInterval::_M;
+}
+
+static void addRange(std::vector<CandleRange>& ranges, CandleRange range) {
+    std::vector<CandleRange> retVal;
+    retVal.reserve(ranges.size() + 1);
+
+    for (const auto& existing: ranges) {
+        /// Adjacent ranges are merged as well, the ends are inclusive
+        if (existing.to + 1 < range.from || range.to + 1 < existing.from) {
+            retVal.push_back(existing);
+        } else {
+            range = {std::min(range.from, existing.from), std::max(range.to, existing.to)};
+        }
+    }
+
+    retVal.push_back(range);
+    std::ranges::sort(retVal, {}, &CandleRange::from);
+    ranges = std::move(retVal);
+}
+
+static void removeRange(std::vector<CandleRange>& ranges, const CandleRange& range) {
+    std::vector<CandleRange> retVal;
+    retVal.reserve(ranges.size() + 1);
+
+    for (const auto& existing: ranges) {
+        if (existing.to < range.from || range.to < existing.from) {
+            retVal.push_back(existing);
+            continue;
+        }
+
+        if (existing.from < range.from) {
+            retVal.push_back({existing.from, range.from - 1});
+        }
+
+        if (range.to < existing.to) {
+            retVal.push_back({range.to + 1, existing.to});
+        }
+    }
+
+    ranges = std::move(retVal);
+}
+
+static std::vector<CandleRange> missingRanges(const std::vector<CandleRange>& ranges, const std::int64_t from, const std::int64_t to) {
+    std::vector<CandleRange> retVal;
+    auto next = from;
+
+    for (const auto& range: ranges) {
+        if (range.to < next) {
+            continue;
+        }
+
+        if (range.from > to) {
+            break;
+        }
+
+        if (range.from > next) {
+            retVal.push_back({next, range.from - 1});
+        }
+
+        next = range.to + 1;
+    }
+
+    if (next <= to) {
+        retVal.push_back({next, to});
+    }
+
+    return retVal;
+}
+
+/**
+ * @return ranges between consecutive candles which should contain candles, the same check as comparing the distance
+ * of start times with the interval
+ */
+static std::vector<CandleRange> findHoles(const std::vector<Candle>& candles, const std::int64_t intervalMs) {
+    std::vector<CandleRange> retVal;
+
+    for (std::size_t i = 1; i < candles.size(); ++i) {
+        if (candles[i].startTime - candles[i - 1].startTime > intervalMs) {
+            retVal.push_back({candles[i - 1].startTime + intervalMs, candles[i].startTime - intervalMs});
+        }
+    }
+
+    return retVal;
+}
+
+/**
+ * @return ranges within from and to which should contain candles, the holes between consecutive candles and the edges
+ * before the first and after the last candle, the whole range if there are no candles
+ */
+static std::vector<CandleRange> findMissing(const std::vector<Candle>& candles, const std::int64_t from, const std::int64_t to,
+                                            const std::int64_t intervalMs) {
+    if (candles.empty()) {
+        return {{from, to}};
+    }
+
+    std::vector<CandleRange> retVal;
+
+    if (candles.front().startTime - intervalMs >= from) {
+        retVal.push_back({from, candles.front().startTime - intervalMs});
+    }
+
+    for (const auto& hole: findHoles(candles, intervalMs)) {
+        retVal.push_back(hole);
+    }
+
+    if (candles.back().startTime + intervalMs <= to) {
+        retVal.push_back({candles.back().startTime + intervalMs, to});
+    }
+
+    return retVal;
+}
+
+static std::vector<CandleRange> loadRanges(const std::filesystem::path& path) {
+    std::vector<CandleRange> retVal;
+    std::ifstream ifs(path);
+    CandleRange range;
+
+    while (ifs >> range.from >> range.to) {
+        retVal.push_back(range);
+    }
+
+    return retVal;
+}
+
+static void saveRanges(const std::filesystem::path& path, const std::vector<CandleRange>& ranges) {
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::trunc);
+
+        for (const auto& range: ranges) {
+            ofs << range.from << " " << range.to << "\n";
+        }
+
+        if (!ofs.flush()) {
+            throw std::runtime_error("Could not write candle ranges: " + tmpPath.string());
+        }
+    }
+
+    std::filesystem::rename(tmpPath, path);
+}
+
+static std::string chunkExtension(const CandleEncoding encoding) {
+    return encoding == CandleEncoding::Compressed ? ".vbc" : ".bin";
+}
+
+static std::vector<Candle> decodeRawChunk(const std::string& data) {
+    std::vector<Candle> retVal;
+    retVal.resize(data.size() / CANDLE_RECORD_SIZE);
+
+    for (std::size_t i = 0; i < retVal.size(); ++i) {
+        const auto* record = data.data() + i * CANDLE_RECORD_SIZE;
+        auto& candle = retVal[i];
+        std::memcpy(&candle.startTime, record, sizeof(std::int64_t));
+        record += sizeof(std::int64_t);
+
+        for (auto* value: {&candle.open, &candle.high, &candle.low, &candle.close, &candle.volume, &candle.turnover}) {
+            std::memcpy(value, record, sizeof(double));
+            record += sizeof(double);
+        }
+    }
+
+    return retVal;
+}
+
+static std::string encodeRawChunk(const std::vector<Candle>& candles) {
+    std::string data(candles.size() * CANDLE_RECORD_SIZE, '\0');
+
+    for (std::size_t i = 0; i < candles.size(); ++i) {
+        auto* record = data.data() + i * CANDLE_RECORD_SIZE;
+        const auto& candle = candles[i];
+        std::memcpy(record, &candle.startTime, sizeof(std::int64_t));
+        record += sizeof(std::int64_t);
+
+        for (const auto* value: {&candle.open, &candle.high, &candle.low, &candle.close, &candle.volume, &candle.turnover}) {
+            std::memcpy(record, value, sizeof(double));
+            record += sizeof(double);
+        }
+    }
+
+    return data;
+}
+
+/**
+ * Read the chunk in any encoding, a damaged compressed chunk reads as empty and verify() finds it as a hole
+ */
+static std::vector<Candle> readChunk(const std::filesystem::path& path) {
+    for (const auto encoding: {CandleEncoding::Raw, CandleEncoding::Compressed}) {
+        auto chunkPath = path;
+        chunkPath += chunkExtension(encoding);
+        std::ifstream file(chunkPath, std::ios::binary);
+
+        if (!file) {
+            continue;
+        }
+
+        const std::string data{std::istreambuf_iterator(file), std::istreambuf_iterator<char>()};
+
+        if (encoding == CandleEncoding::Raw) {
+            return decodeRawChunk(data);
+        }
+
+        try {
+            return CandleCodec::decode(data);
+        } catch (const std::runtime_error&) {
+            return {};
+        }
+    }
+
+    return {};
+}
+
+/**
+ * Write the chunk to a temporary file and rename it, so a crash never leaves a truncated chunk. The chunk of the other
+ * encoding is removed afterwards.
+ */
+static void writeChunk(const std::filesystem::path& path, const std::vector<Candle>& candles, const CandleEncoding encoding) {
+    const auto data = encoding == CandleEncoding::Compressed ? CandleCodec::encode(candles) : encodeRawChunk(candles);
+    auto chunkPath = path;
+    chunkPath += chunkExtension(encoding);
+
+    auto tmpPath = chunkPath;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+        if (!file.flush()) {
+            throw std::runtime_error("Could not write candle chunk: " + tmpPath.string());
+        }
+    }
+
+    std::filesystem::rename(tmpPath, chunkPath);
+
+    auto otherPath = path;
+    otherPath += chunkExtension(encoding == CandleEncoding::Raw ? CandleEncoding::Compressed : CandleEncoding::Raw);
+    std::filesystem::remove(otherPath);
+}
+
+struct CandleStore::P {
+    struct Series {
+        /// Guards the ranges, the gaps and the chunk files, it is not held during the downloads
+        mutable std::mutex locker;
+        std::filesystem::path directory;
+        std::int64_t intervalMs = 0;
+        std::int64_t chunkMs = 0;
+        CandleEncoding encoding = CandleEncoding::Raw;
+        std::vector<CandleRange> ranges;
+        /// Parts of the synchronized ranges without candles on the exchange, e.g. trading halts or before the listing
+        std::vector<CandleRange> gaps;
+
+        /// Path without the extension of the encoding
+        [[nodiscard]] std::filesystem::path chunkPath(const std::int64_t chunk) const {
+            return directory / std::to_string(chunk);
+        }
+
+        void load() {
+            ranges = loadRanges(directory / "ranges");
+            gaps = loadRanges(directory / "gaps");
+        }
+
+        /**
+         * The gaps are written first, a crash in between leaves gaps of a range which is not synchronized, they are
+         * replaced when the range is downloaded
+         */
+        void save() const {
+            saveRanges(directory / "gaps", gaps);
+            saveRanges(directory / "ranges", ranges);
+        }
+
+        /**
+         * Merge the candles into the chunk files, stored candles with the same start time are replaced
+         */
+        void store(std::vector<Candle> candles) const {
+            std::ranges::sort(candles, {}, &Candle::startTime);
+            auto first = candles.begin();
+
+            while (first != candles.end()) {
+                const auto chunk = first->startTime / chunkMs;
+                const auto last = std::find_if(first, candles.end(), [&](const Candle& candle) {
+                    return candle.startTime / chunkMs != chunk;
+                });
+
+                auto stored = readChunk(chunkPath(chunk));
+                std::vector<Candle> merged;
+                merged.reserve(stored.size() + static_cast<std::size_t>(last - first));
+                std::ranges::merge(first, last, stored.begin(), stored.end(), std::back_inserter(merged), {}, &Candle::startTime, &Candle::startTime);
+
+                /// The downloaded candles come first in the merge, so unique keeps them
+                const auto [eraseFirst, eraseLast] = std::ranges::unique(merged, {}, &Candle::startTime);
+                merged.erase(eraseFirst, eraseLast);
+
+                writeChunk(chunkPath(chunk), merged, encoding);
+                first = last;
+            }
+        }
+
+        [[nodiscard]] std::vector<Candle> read(const std::int64_t from, const std::int64_t to) const {
+            std::vector<Candle> retVal;
+
+            for (auto chunk = from / chunkMs; chunk <= to / chunkMs; ++chunk) {
+                for (const auto& candle: readChunk(chunkPath(chunk))) {
+                    if (candle.startTime >= from && candle.startTime <= to) {
+                        retVal.push_back(candle);
+                    }
+                }
+            }
+
+            return retVal;
+        }
+    };
+
+    std::shared_ptr<RESTClient> restClient;
+    std::filesystem::path directory;
+    CandleEncoding encoding = CandleEncoding::Raw;
+    /// Guards the map only, every series has its own lock
+    mutable std::mutex locker;
+    std::map<std::string, Series> series;
+
+    /**
+     * Find or load the series, the reference stays valid for the lifetime of the store
+     */
+    Series& getSeries(const Category category, const std::string& symbol, const CandleInterval interval) {
+        auto key = std::string(magic_enum::enum_name(category));
+        key.append("/").append(symbol).append("/").append(magic_enum::enum_name(interval));
+
+        std::lock_guard lk(locker);
+        const auto [it, isNew] = series.try_emplace(key);
+        auto& retVal = it->second;
+
+        if (isNew) {
+            retVal.directory = directory / magic_enum::enum_name(category) / symbol / magic_enum::enum_name(interval);
+            retVal.intervalMs = Bybit::numberOfMsForCandleInterval(interval);
+            retVal.chunkMs = retVal.intervalMs * CANDLES_PER_CHUNK;
+            retVal.encoding = encoding;
+
+            try {
+                std::filesystem::create_directories(retVal.directory);
+                retVal.load();
+            } catch (...) {
+                series.erase(it);
+                throw;
+            }
+        }
+
+        return retVal;
+    }
+};
+
+CandleStore::CandleStore(std::shared_ptr<RESTClient> restClient, const std::filesystem::path& directory,
+                         const CandleEncoding encoding) : m_p(std::make_unique<P>()) {
+    m_p->restClient = std::move(restClient);
+    m_p->directory = directory;
+    m_p->encoding = encoding;
+    std::filesystem::create_directories(directory);
+}
+
+CandleStore::~CandleStore() = default;
+
+std::vector<Candle> CandleStore::getCandles(const Category category, const std::string& symbol, const CandleInterval interval,
+                                            const std::int64_t from, const std::int64_t to) const {
+    auto& series = m_p->getSeries(category, symbol, interval);
+
+    if (series.intervalMs <= 0 || from > to) {
+        return {};
+    }
+
+    /// A candle is closed when the next one has started
+    const auto closedTo = std::min(to, localTimeInMs() - series.intervalMs);
+
+    if (from <= closedTo) {
+        /// The series is not locked during the downloads, reads of the stored ranges do not wait for them. A range
+        /// downloaded by two calls at once is merged twice, the later write replaces the same candles.
+        std::vector<CandleRange> missing;
+        {
+            std::lock_guard lk(series.locker);
+            missing = missingRanges(series.ranges, from, closedTo);
+        }
+
+        for (const auto& range: missing) {
+            auto candles = m_p->restClient->downloadHistoricalPrices(category, symbol, interval, range.from, range.to);
+
+            /// A hole may be a page lost on the way, the exchange is asked once more. What is still missing then
+            /// does not exist, e.g. a trading halt, and it is recorded as a gap so verify() accepts it.
+            if (hasFixedLength(interval)) {
+                for (const auto& hole: findHoles(candles, series.intervalMs)) {
+                    const auto refetched = m_p->restClient->downloadHistoricalPrices(category, symbol, interval, hole.from, hole.to);
+                    candles.insert(candles.end(), refetched.begin(), refetched.end());
+                }
+
+                std::ranges::sort(candles, {}, &Candle::startTime);
+            }
+
+            std::lock_guard lk(series.locker);
+
+            if (hasFixedLength(interval)) {
+                removeRange(series.gaps, range);
+
+                for (const auto& gap: findMissing(candles, range.from, range.to, series.intervalMs)) {
+                    addRange(series.gaps, gap);
+                }
+            }
+
+            series.store(std::move(candles));
+            addRange(series.ranges, range);
+            series.save();
+        }
+    }
+
+    std::vector<Candle> retVal;
+
+    if (from <= closedTo) {
+        std::lock_guard lk(series.locker);
+        retVal = series.read(from, closedTo);
+    }
+
+    if (closedTo < to) {
+        const auto open = m_p->restClient->downloadHistoricalPrices(category, symbol, interval, std::max(from, closedTo + 1), to);
+        retVal.insert(retVal.end(), open.begin(), open.end());
+    }
+
+    return retVal;
+}
+
+std::vector<CandleRange> CandleStore::getSynchronizedRanges(const Category category, const std::string& symbol,
+                                                            const CandleInterval interval) const {
+    const auto& series = m_p->getSeries(category, symbol, interval);
+    std::lock_guard lk(series.locker);
+    return series.ranges;
+}
+
+std::size_t CandleStore::verify(const Category category, const std::string& symbol, const CandleInterval interval) const {
+    auto& series = m_p->getSeries(category, symbol, interval);
+
+    if (!hasFixedLength(interval)) {
+        return 0;
+    }
+
+    std::lock_guard lk(series.locker);
+
+    std::size_t retVal = 0;
+
+    for (const auto& range: std::vector(series.ranges)) {
+        auto holes = findMissing(series.read(range.from, range.to), range.from, range.to, series.intervalMs);
+
+        for (const auto& gap: series.gaps) {
+            removeRange(holes, gap);
+        }
+
+        for (const auto& hole: holes) {
+            removeRange(series.ranges, hole);
+            ++retVal;
+        }
+    }
+
+    if (retVal > 0) {
+        series.save();
+    }
+
+    return retVal;
+}
+} // namespace vk::bybit
@@ -0,0 +1,214 @@
+/**
+Bybit DNS Cache
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_dns_cache.h"
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace vk::bybit {
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+static constexpr int DEFAULT_DNS_TTL_IN_S = 60;
+static constexpr int REFRESH_CHECK_INTERVAL_IN_S = 1;
+
+/// Entries which were not asked for during this number of TTLs are not refreshed anymore and are dropped
+static constexpr int UNUSED_ENTRY_TTLS = 10;
+
+struct DNSCache::P {
+    struct Entry {
+        std::vector<tcp::endpoint> endpoints;
+        std::chrono::steady_clock::time_point expiresAt{};
+        std::chrono::steady_clock::time_point lastUsed{};
+        bool isRefreshing = false;
+    };
+
+    using Key = std::pair<std::string, std::string>;
+
+    net::io_context ioc;
+    net::executor_work_guard<net::io_context::executor_type> workGuard;
+    tcp::resolver resolver;
+    net::steady_timer refreshTimer;
+    std::thread refreshThread;
+    std::once_flag refreshStarted;
+    std::mutex locker;
+    std::map<Key, Entry> entries;
+    std::chrono::seconds ttl{DEFAULT_DNS_TTL_IN_S};
+
+    P() : workGuard(net::make_work_guard(ioc)), resolver(ioc), refreshTimer(ioc) {}
+
+    ~P() {
+        workGuard.reset();
+        ioc.stop();
+
+        if (refreshThread.joinable()) {
+            refreshThread.join();
+        }
+    }
+
+    static std::vector<tcp::endpoint> toEndpoints(const tcp::resolver::results_type& results) {
+        std::vector<tcp::endpoint> retVal;
+        retVal.reserve(results.size());
+
+        for (const auto& result : results) {
+            retVal.push_back(result.endpoint());
+        }
+
+        return retVal;
+    }
+
+    /**
+     * Get the cached endpoints and mark the entry as used
+     */
+    std::optional<std::vector<tcp::endpoint>> find(const Key& key) {
+        std::lock_guard lk(locker);
+
+        if (const auto it = entries.find(key); it != entries.end()) {
+            it->second.lastUsed = std::chrono::steady_clock::now();
+            return it->second.endpoints;
+        }
+
+        return std::nullopt;
+    }
+
+    /**
+     * Cache the endpoints of a host resolved by a caller and start refreshing it in the background
+     */
+    void store(const Key& key, const std::vector<tcp::endpoint>& endpoints) {
+        if (endpoints.empty()) {
+            throw boost::system::system_error{net::error::host_not_found};
+        }
+
+        {
+            std::lock_guard lk(locker);
+            Entry entry;
+            entry.endpoints = endpoints;
+            entry.lastUsed = std::chrono::steady_clock::now();
+            entry.expiresAt = entry.lastUsed + ttl;
+            entries.insert_or_assign(key, std::move(entry));
+        }
+
+        startRefreshing();
+    }
+
+    void startRefreshing() {
+        std::call_once(refreshStarted, [this] {
+            scheduleRefresh();
+            refreshThread = std::thread([this] { ioc.run(); });
+        });
+    }
+
+    void scheduleRefresh() {
+        refreshTimer.expires_after(std::chrono::seconds(REFRESH_CHECK_INTERVAL_IN_S));
+        refreshTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (ec) {
+                return;
+            }
+
+            refreshExpiring();
+            scheduleRefresh();
+        });
+    }
+
+    /**
+     * Start asynchronous resolving of all entries which expire within a quarter of TTL, runs on the refresh thread
+     */
+    void refreshExpiring() {
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<Key> toRefresh;
+        {
+            std::lock_guard lk(locker);
+
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (now - it->second.lastUsed > UNUSED_ENTRY_TTLS * ttl) {
+                    it = entries.erase(it);
+                    continue;
+                }
+
+                if (!it->second.isRefreshing && it->second.expiresAt - now < ttl / 4) {
+                    it->second.isRefreshing = true;
+                    toRefresh.push_back(it->first);
+                }
+
+                ++it;
+            }
+        }
+
+        for (const auto& key : toRefresh) {
+            resolver.async_resolve(key.first, key.second, [this, key](const boost::system::error_code& ec, const tcp::resolver::results_type& results) {
+                std::lock_guard lk(locker);
+
+                if (const auto it = entries.find(key); it != entries.end()) {
+                    it->second.isRefreshing = false;
+
+                    /// Keep serving the stale endpoints if the refresh failed, it will be retried with the next check
+                    if (!ec && !results.empty()) {
+                        it->second.endpoints = toEndpoints(results);
+                        it->second.expiresAt = std::chrono::steady_clock::now() + ttl;
+                    }
+                }
+            });
+        }
+    }
+};
+
+DNSCache::DNSCache() : m_p(std::make_unique<P>()) {}
+
+DNSCache::~DNSCache() = default;
+
+DNSCache& DNSCache::instance() {
+    /// Intentionally never destroyed like the TLSContext, sessions closed during the static destruction may still resolve
+    static auto* instance = new DNSCache();
+    return *instance;
+}
+
+std::vector<tcp::endpoint> DNSCache::resolve(const std::string& host, const std::string& port) const {
+    const auto key = P::Key{host, port};
+
+    if (auto endpoints = m_p->find(key)) {
+        return std::move(*endpoints);
+    }
+
+    /// Cache miss, the dedicated resolver is used so that the refresh thread is not blocked
+    tcp::resolver resolver{m_p->ioc};
+    auto endpoints = P::toEndpoints(resolver.resolve(host, port));
+    m_p->store(key, endpoints);
+    return endpoints;
+}
+
+net::awaitable<std::vector<tcp::endpoint>> DNSCache::resolveAsync(const std::string host, const std::string port) const {
+    const auto key = P::Key{host, port};
+
+    if (auto endpoints = m_p->find(key)) {
+        co_return std::move(*endpoints);
+    }
+
+    /// Cache miss, resolved on the executor of the caller without blocking its thread
+    tcp::resolver resolver{co_await net::this_coro::executor};
+    auto endpoints = P::toEndpoints(co_await resolver.async_resolve(host, port, net::use_awaitable));
+    m_p->store(key, endpoints);
+    co_return endpoints;
+}
+
+void DNSCache::invalidate(const std::string& host, const std::string& port) const {
+    std::lock_guard lk(m_p->locker);
+    m_p->entries.erase(P::Key{host, port});
+}
+
+void DNSCache::setTimeToLive(const std::chrono::seconds ttl) const {
+    std::lock_guard lk(m_p->locker);
+    m_p->ttl = ttl;
+}
+} // namespace vk::bybit
@@ -11,6 +11,24 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 #include "vk/utils/json_utils.h"
 
 namespace vk::bybit {
+EventView::EventView(const JsonView& json) {
+    for (auto it = json.begin(); it != json.end(); ++it) {
+        if (const auto key = it.key(); key == "topic") {
+            topic = (*it).asString();
+        } else if (key == "ts") {
+            ts = (*it).asInt64();
+        } else if (key == "data") {
+            data = *it;
+        } else if (key == "type") {
+            if (const auto value = magic_enum::enum_cast<ResponseType>((*it).asString())) {
+                type = *value;
+            }
+        } else if (key == "success") {
+            isControl = true;
+        }
+    }
+}
+
 nlohmann::json Event::toJson() const {
     throw std::runtime_error("Unimplemented: Event::toJson()");
 }
@@ -22,6 +40,13 @@ void Event::fromJson(const nlohmann::json& json) {
     data = json["data"];
 }
 
+void Event::fromEventView(const EventView& eventView) {
+    topic = eventView.topic;
+    type = eventView.type;
+    ts = eventView.ts;
+    data = eventView.data.empty() ? nlohmann::json{} : nlohmann::json::parse(eventView.data.raw());
+}
+
 nlohmann::json EventTicker::toJson() const {
     throw std::runtime_error("Unimplemented: EventTicker::toJson()");
 }
@@ -35,6 +60,29 @@ void EventTicker::fromJson(const nlohmann::json& json) {
     lastPrice = readStringAsDouble(json, "lastPrice", lastPrice);
 }
 
+void EventTicker::fromJson(const JsonView& json) {
+    /// One pass over the members, deltas carry only the changed fields and the others keep their values
+    for (auto it = json.begin(); it != json.end(); ++it) {
+        if (const auto key = it.key(); key == "symbol") {
+            symbol = (*it).asString();
+        } else if (key == "ask1Price") {
+            ask1Price = (*it).asDouble(ask1Price);
+        } else if (key == "ask1Size") {
+            ask1Size = (*it).asDouble(ask1Size);
+        } else if (key == "bid1Price") {
+            bid1Price = (*it).asDouble(bid1Price);
+        } else if (key == "bid1Size") {
+            bid1Size = (*it).asDouble(bid1Size);
+        } else if (key == "lastPrice") {
+            lastPrice = (*it).asDouble(lastPrice);
+        }
+    }
+}
+
+void EventTicker::loadEventData(const EventView& event) {
+    fromJson(event.data);
+}
+
 void EventTicker::loadEventData(const Event& event) {
     switch (event.type) {
     case ResponseType::snapshot:
@@ -63,4 +111,32 @@ void EventCandlestick::fromJson(const nlohmann::json& json) {
     readValue<bool>(json, "confirm", confirm);
     readValue<std::int64_t>(json, "timestamp", timestamp);
 }
+
+void EventCandlestick::fromJson(const JsonView& json) {
+    for (auto it = json.begin(); it != json.end(); ++it) {
+        if (const auto key = it.key(); key == "start") {
+            start = (*it).asInt64(start);
+        } else if (key == "end") {
+            end = (*it).asInt64(end);
+        } else if (key == "interval") {
+            interval = (*it).asString();
+        } else if (key == "open") {
+            open = (*it).asDouble(open);
+        } else if (key == "high") {
+            high = (*it).asDouble(high);
+        } else if (key == "low") {
+            low = (*it).asDouble(low);
+        } else if (key == "close") {
+            close = (*it).asDouble(close);
+        } else if (key == "volume") {
+            volume = (*it).asDouble(volume);
+        } else if (key == "turnover") {
+            turnover = (*it).asDouble(turnover);
+        } else if (key == "confirm") {
+            confirm = (*it).asBool(confirm);
+        } else if (key == "timestamp") {
+            timestamp = (*it).asInt64(timestamp);
+        }
+    }
+}
 }
@@ -0,0 +1,93 @@
+/**
+Bybit HMAC Request Signer
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_hmac_signer.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace vk::bybit {
+static constexpr std::size_t SHA256_BLOCK_SIZE = 64;
+
+struct HMACSigner::P {
+    EVP_MD_CTX* inner = EVP_MD_CTX_new();
+    EVP_MD_CTX* outer = EVP_MD_CTX_new();
+
+    explicit P(const std::string& secret) {
+        if (!inner || !outer) {
+            throw std::runtime_error("HMACSigner: EVP_MD_CTX_new failed");
+        }
+
+        unsigned char key[SHA256_BLOCK_SIZE] = {};
+
+        /// Keys longer than the block size are hashed first (RFC 2104)
+        if (secret.size() > SHA256_BLOCK_SIZE) {
+            SHA256(reinterpret_cast<const unsigned char*>(secret.data()), secret.size(), key);
+        } else {
+            std::memcpy(key, secret.data(), secret.size());
+        }
+
+        initPadded(inner, key, 0x36);
+        initPadded(outer, key, 0x5c);
+        OPENSSL_cleanse(key, sizeof(key));
+    }
+
+    ~P() {
+        EVP_MD_CTX_free(inner);
+        EVP_MD_CTX_free(outer);
+    }
+
+    static void initPadded(EVP_MD_CTX* ctx, const unsigned char* key, const unsigned char pad) {
+        unsigned char block[SHA256_BLOCK_SIZE];
+
+        for (std::size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+            block[i] = key[i] ^ pad;
+        }
+
+        const auto isOk = EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) && EVP_DigestUpdate(ctx, block, sizeof(block));
+        OPENSSL_cleanse(block, sizeof(block));
+
+        if (!isOk) {
+            throw std::runtime_error("HMACSigner: digest initialization failed");
+        }
+    }
+};
+
+HMACSigner::HMACSigner(const std::string& secret) : m_p(std::make_unique<P>(secret)) {}
+
+HMACSigner::~HMACSigner() = default;
+
+void HMACSigner::sign(const std::string_view message, Signature& signature) const {
+    /// Scratch context reused by all signatures of the calling thread
+    struct Scratch {
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+
+        ~Scratch() { EVP_MD_CTX_free(ctx); }
+    };
+
+    thread_local Scratch scratch;
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    unsigned int digestLength = SHA256_DIGEST_LENGTH;
+
+    if (!EVP_MD_CTX_copy_ex(scratch.ctx, m_p->inner) || !EVP_DigestUpdate(scratch.ctx, message.data(), message.size()) ||
+        !EVP_DigestFinal_ex(scratch.ctx, digest, &digestLength) || !EVP_MD_CTX_copy_ex(scratch.ctx, m_p->outer) ||
+        !EVP_DigestUpdate(scratch.ctx, digest, digestLength) || !EVP_DigestFinal_ex(scratch.ctx, digest, &digestLength)) {
+        throw std::runtime_error("HMACSigner: signing failed");
+    }
+
+    static constexpr char hexDigits[] = "0123456789abcdef";
+
+    for (std::size_t i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        signature[2 * i] = hexDigits[digest[i] >> 4];
+        signature[2 * i + 1] = hexDigits[digest[i] & 0x0f];
+    }
+}
+} // namespace vk::bybit
@@ -7,12 +7,30 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 */
 
 #include "vk/bybit/bybit_http_session.h"
+#include "vk/bybit/bybit_tls_context.h"
+#include "vk/bybit/bybit_dns_cache.h"
+#include "vk/bybit/bybit_hmac_signer.h"
+#include "vk/bybit/bybit_server_clock.h"
 #include "vk/utils/utils.h"
 #include "vk/utils/json_utils.h"
 #include "nlohmann/json.hpp"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/redirect_error.hpp>
 #include <boost/asio/ssl.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/use_future.hpp>
 #include <boost/beast/version.hpp>
-#include <openssl/hmac.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 namespace vk::bybit {
 namespace ssl = boost::asio::ssl;
@@ -21,36 +39,376 @@ using tcp = net::ip::tcp;
 auto API_MAINNET_URI = "api.bybit.com";
 auto API_TESTNET_URI = "api-testnet.bybit.com";
 
+static constexpr int IDLE_CONNECTION_TIMEOUT_IN_S = 30;
+static constexpr std::size_t MAX_IDLE_CONNECTIONS = 8;
+static constexpr int CLOCK_SYNC_INTERVAL_IN_S = 60;
+static constexpr int CLOCK_SYNC_SAMPLES = 4;
+static constexpr int DEFAULT_RECEIVE_WINDOW_IN_MS = 5000;
+
+static std::int64_t localTimeInUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Forwards the token cancellation to the stream of the pending request. The cancellation is posted to the executor of
+ * the request, so the stream is touched only from the thread running the request.
+ */
+class CancellationScope {
+    const CancellationToken* m_token = nullptr;
+    std::shared_ptr<beast::tcp_stream*> m_stream = std::make_shared<beast::tcp_stream*>(nullptr);
+    std::size_t m_handlerId = 0;
+
+public:
+    CancellationScope(const std::optional<CancellationToken>& token, const net::any_io_executor& executor) {
+        if (!token) {
+            return;
+        }
+
+        m_token = &*token;
+        m_handlerId = m_token->registerHandler([executor, stream = std::weak_ptr(m_stream)] {
+            net::post(executor, [stream] {
+                if (const auto target = stream.lock(); target && *target) {
+                    (*target)->cancel();
+                }
+            });
+        });
+    }
+
+    CancellationScope(const CancellationScope&) = delete;
+
+    CancellationScope& operator=(const CancellationScope&) = delete;
+
+    ~CancellationScope() {
+        if (m_token && m_handlerId) {
+            m_token->unregisterHandler(m_handlerId);
+        }
+    }
+
+    void bind(beast::tcp_stream* stream) const { *m_stream = stream; }
+
+    [[nodiscard]] bool isCancelled() const { return m_token && m_token->isCancelled(); }
+
+    /**
+     * @throws boost::system::system_error with operation_aborted if the token was cancelled
+     */
+    void check() const {
+        if (isCancelled()) {
+            throw boost::system::system_error{net::error::operation_aborted};
+        }
+    }
+};
+
+/// TLS connection bound to the executor of the coroutine which dialed it
+struct Connection {
+    ssl::stream<beast::tcp_stream> stream;
+    beast::flat_buffer buffer;
+    std::chrono::steady_clock::time_point lastUsed{};
+    std::size_t numRequests = 0;
+
+    Connection(const net::any_io_executor &executor, ssl::context &ctx) : stream(executor, ctx) {}
+
+    [[nodiscard]] const net::execution_context* context() {
+        return &net::query(stream.get_executor(), net::execution::context);
+    }
+
+    /**
+     * Check that the peer has not closed the idle connection, peeks the socket without blocking
+     * @return True if the connection can be reused
+     */
+    [[nodiscard]] bool isAlive() {
+        auto &socket = beast::get_lowest_layer(stream).socket();
+
+        if (!socket.is_open()) {
+            return false;
+        }
+
+        beast::error_code ec;
+        socket.non_blocking(true, ec);
+
+        if (ec) {
+            return false;
+        }
+
+        char byte;
+        [[maybe_unused]] const auto bytesPeeked = socket.receive(net::buffer(&byte, 1), tcp::socket::message_peek, ec);
+        const auto isOpen = !ec || ec == net::error::would_block;
+        socket.non_blocking(false, ec);
+        return isOpen;
+    }
+};
+
+/**
+ * Idle connections of all executors of a session, most recently used last. The pool is shared with the
+ * ConnectionPoolService of every execution context it holds a connection of.
+ */
+struct ConnectionPool {
+    std::mutex locker;
+    std::deque<std::unique_ptr<Connection>> idleConnections;
+
+    void drop(const net::execution_context* context) {
+        std::lock_guard lk(locker);
+        std::erase_if(idleConnections, [context](const auto& connection) { return connection->context() == context; });
+    }
+};
+
+/**
+ * Service of an execution context holding the pooled connections, the context shuts its services down before it
+ * destroys them and the idle connections bound to it are dropped then. A socket is never closed after its context.
+ */
+class ConnectionPoolService : public net::execution_context::service {
+    std::mutex m_locker;
+    std::vector<std::weak_ptr<ConnectionPool>> m_pools;
+
+public:
+    using key_type = ConnectionPoolService;
+    static inline net::execution_context::id id;
+
+    explicit ConnectionPoolService(net::execution_context& context) : service(context) {}
+
+    void add(const std::shared_ptr<ConnectionPool>& pool) {
+        std::lock_guard lk(m_locker);
+        std::erase_if(m_pools, [](const auto& existing) { return existing.expired(); });
+
+        if (std::ranges::none_of(m_pools, [&pool](const auto& existing) { return existing.lock() == pool; })) {
+            m_pools.push_back(pool);
+        }
+    }
+
+private:
+    void shutdown() override {
+        std::vector<std::weak_ptr<ConnectionPool>> pools;
+        {
+            std::lock_guard lk(m_locker);
+            pools.swap(m_pools);
+        }
+
+        for (const auto& pool: pools) {
+            if (const auto target = pool.lock()) {
+                target->drop(&context());
+            }
+        }
+    }
+};
+
 struct HTTPSession::P {
+    /// Runs the synchronous requests, so the blocking API is a thin wrapper over the asynchronous one
     net::io_context ioc;
+    net::executor_work_guard<net::io_context::executor_type> workGuard;
+    std::thread ioThread;
+    std::shared_ptr<ConnectionPool> pool = std::make_shared<ConnectionPool>();
     std::string apiKey;
-    int receiveWindow = 25000;
-    std::string apiSecret;
+    std::atomic_int receiveWindow = DEFAULT_RECEIVE_WINDOW_IN_MS;
+    std::unique_ptr<HMACSigner> signer;
     std::string uri;
-    const EVP_MD* evpMd;
+    ServerClock serverClock;
+    std::atomic_bool clockSyncRunning = false;
 
-    P() : evpMd(EVP_sha256()) {}
+    P() : workGuard(net::make_work_guard(ioc)) {
+        ioThread = std::thread([this] { ioc.run(); });
+    }
 
-    http::response<http::string_body> request(http::request<http::string_body> req);
+    ~P() {
+        workGuard.reset();
+        ioc.stop();
 
-    static std::string createQueryStr(const std::map<std::string, std::string>& parameters) {
-        std::string queryStr;
+        if (ioThread.joinable()) {
+            ioThread.join();
+        }
+
+        pool->idleConnections.clear();
+    }
+
+    /// Timestamps and signs the request, it is called right before every write attempt
+    using Authenticator = std::function<void(http::request<http::string_body>&)>;
+
+    /**
+     * Send the request on a pooled or a new connection, the request is signed after the connection is acquired, so
+     * neither the dial nor a retry on a new connection eats up the receive window
+     */
+    net::awaitable<http::response<http::string_body>> request(http::request<http::string_body> req, const Authenticator& authenticate = {}, const RequestOptions& options = {});
+
+    /**
+     * Take a burst of samples of the server time, only the fastest ones are used by the estimator
+     */
+    net::awaitable<void> synchronizeClock() {
+        for (int i = 0; i < CLOCK_SYNC_SAMPLES; ++i) {
+            http::request<http::string_body> req{http::verb::get, "/v5/market/time", 11};
+
+            const auto sendTime = localTimeInUs();
+            const auto response = co_await request(std::move(req));
+            const auto receiveTime = localTimeInUs();
+
+            if (response.result() != http::status::ok) {
+                continue;
+            }
+
+            const auto json = nlohmann::json::parse(response.body(), nullptr, false);
+
+            if (json.is_discarded() || !json.contains("result") || !json["result"].contains("timeNano")) {
+                continue;
+            }
+
+            const auto serverTime = std::stoll(json["result"]["timeNano"].get<std::string>()) / 1000;
+            serverClock.addSample(sendTime, serverTime, receiveTime);
+        }
+    }
+
+    /**
+     * Take a burst of samples in the background on the IO thread, a burst already running is not started again
+     */
+    void startClockSync() {
+        if (clockSyncRunning.exchange(true)) {
+            return;
+        }
+
+        net::co_spawn(ioc, [this]() -> net::awaitable<void> {
+            try {
+                co_await synchronizeClock();
+            } catch (const std::exception&) {
+                /// Requests are signed with the local time, the next signed request starts over
+            }
+
+            clockSyncRunning = false;
+        }, net::detached);
+    }
 
-        for (const auto& [fst, snd]: parameters) {
-            queryStr.append(fst);
-            queryStr.append("=");
-            queryStr.append(snd);
-            queryStr.append("&");
+    /**
+     * Signed requests never wait for the clock, they are timestamped by the local time until the first burst started
+     * by the constructor completes. Later the clock is kept up to date by the response headers and by a periodic
+     * synchronization running in the background. The headers have the ms resolution only, so they do not postpone it.
+     */
+    void keepClockSynchronized() {
+        if (apiKey.empty()) {
+            return;
         }
 
-        if (!queryStr.empty()) {
-            queryStr.pop_back();
+        if (!serverClock.isSynchronized() || serverClock.timeSinceLastActiveSample() > std::chrono::seconds(CLOCK_SYNC_INTERVAL_IN_S)) {
+            startClockSync();
+        }
+    }
+
+    net::awaitable<std::unique_ptr<Connection>> connect(const net::any_io_executor &executor, const RequestDeadlines &deadlines, const CancellationScope &cancellation) const {
+        const auto &tlsContext = TLSContext::instance();
+        auto connection = std::make_unique<Connection>(executor, tlsContext.context());
+        auto &tcpStream = beast::get_lowest_layer(connection->stream);
+        cancellation.bind(&tcpStream);
+
+        // Set SNI Hostname (many hosts need this to handshake successfully) and resume the last TLS session
+        if (!tlsContext.prepareHandshake(connection->stream.native_handle(), uri)) {
+            boost::system::error_code ec{static_cast<int>(ERR_get_error()), net::error::get_ssl_category()};
+            throw boost::system::system_error{ec};
+        }
+
+        /// Endpoints are tried one by one, the host is re-resolved next time only when all of them failed
+        const auto &dnsCache = DNSCache::instance();
+        const auto endpoints = co_await dnsCache.resolveAsync(uri, "443");
+        cancellation.check();
+
+        beast::error_code ec = beast::error::timeout;
+        bool isTimeoutOnly = true;
+        const auto connectDeadline = std::chrono::steady_clock::now() + deadlines.connect;
+
+        for (std::size_t i = 0; i < endpoints.size(); ++i) {
+            /// The rest of the budget is split between the remaining endpoints, a blackholed address does not use it up
+            const auto remaining = connectDeadline - std::chrono::steady_clock::now();
+
+            if (remaining <= std::chrono::steady_clock::duration::zero()) {
+                break;
+            }
+
+            beast::error_code ignored;
+            tcpStream.socket().close(ignored);
+            tcpStream.expires_after(remaining / static_cast<int>(endpoints.size() - i));
+            co_await tcpStream.async_connect(endpoints[i], net::redirect_error(net::use_awaitable, ec));
+            cancellation.check();
+
+            if (!ec) {
+                break;
+            }
+
+            isTimeoutOnly = isTimeoutOnly && ec == beast::error::timeout;
+        }
+
+        if (ec) {
+            /// Timeouts only say nothing about the endpoints, it may be the local network
+            if (!isTimeoutOnly) {
+                dnsCache.invalidate(uri, "443");
+            }
+
+            throw boost::system::system_error{ec};
+        }
+
+        tcpStream.socket().set_option(tcp::no_delay(true));
+        tcpStream.expires_after(deadlines.tls);
+        co_await connection->stream.async_handshake(ssl::stream_base::client, net::redirect_error(net::use_awaitable, ec));
+        cancellation.check();
+
+        if (ec) {
+            throw boost::system::system_error{ec};
+        }
+
+        co_return connection;
+    }
+
+    /**
+     * Take the most recently used idle connection bound to the executor from the pool, connections idle for too long
+     * or closed by the peer are evicted. Dial a new one if there is no usable connection.
+     */
+    net::awaitable<std::unique_ptr<Connection>> acquireConnection(const net::any_io_executor &executor, const RequestDeadlines &deadlines, const CancellationScope &cancellation) {
+        const auto now = std::chrono::steady_clock::now();
+
+        for (;;) {
+            std::unique_ptr<Connection> connection;
+            {
+                std::lock_guard lk(pool->locker);
+                auto& idleConnections = pool->idleConnections;
+
+                while (!idleConnections.empty() && now - idleConnections.front()->lastUsed > std::chrono::seconds(IDLE_CONNECTION_TIMEOUT_IN_S)) {
+                    idleConnections.pop_front();
+                }
+
+                for (auto it = idleConnections.rbegin(); it != idleConnections.rend(); ++it) {
+                    if ((*it)->stream.get_executor() == executor) {
+                        connection = std::move(*it);
+                        idleConnections.erase(std::next(it).base());
+                        break;
+                    }
+                }
+            }
+
+            if (!connection) {
+                break;
+            }
+
+            if (connection->isAlive()) {
+                co_return connection;
+            }
+        }
+
+        co_return co_await connect(executor, deadlines, cancellation);
+    }
+
+    void onResponse(const http::response<http::string_body>& response, std::int64_t sendTime, std::int64_t receiveTime);
+
+    void releaseConnection(std::unique_ptr<Connection> connection, const bool keepAlive) {
+        if (!keepAlive) {
+            return;
+        }
+
+        connection->lastUsed = std::chrono::steady_clock::now();
+        net::use_service<ConnectionPoolService>(net::query(connection->stream.get_executor(), net::execution::context)).add(pool);
+
+        std::lock_guard lk(pool->locker);
+        pool->idleConnections.push_back(std::move(connection));
+
+        if (pool->idleConnections.size() > MAX_IDLE_CONNECTIONS) {
+            pool->idleConnections.pop_front();
         }
-        return queryStr;
     }
 
     void authenticatePost(http::request<http::string_body>& req, const nlohmann::json& json) const {
-        const auto ts = getMsTimestamp(currentTime()).count();
+        const auto ts = serverClock.now();
+        const int receiveWindow = this->receiveWindow;
 
         nlohmann::json extendedJson = json;
         extendedJson["timestamp"] = ts;
@@ -59,14 +417,10 @@ struct HTTPSession::P {
 
         const std::string queryString = queryStringFromJson(extendedJson);
 
-        unsigned char digest[SHA256_DIGEST_LENGTH];
-        unsigned int digestLength = SHA256_DIGEST_LENGTH;
+        HMACSigner::Signature signature;
+        signer->sign(queryString, signature);
 
-        HMAC(evpMd, apiSecret.data(), static_cast<int>(apiSecret.size()), reinterpret_cast<const unsigned char*>(queryString.data()), queryString.length(), digest, &digestLength);
-
-        std::string signature = stringToHex(digest, sizeof(digest));
-
-        extendedJson["sign"] = signature;
+        extendedJson["sign"] = std::string(signature.data(), signature.size());
 
         req.body() = extendedJson.dump();
         req.prepare_payload();
@@ -74,99 +428,173 @@ struct HTTPSession::P {
         req.set(http::field::content_type, "application/json");
     }
 
-    void authenticateNonPost(http::request<http::string_body>& req) const {
-        std::string path(req.target());
-        const std::size_t pos = path.find('?');
-        std::string queryString;
-
-        if (pos != std::string::npos) {
-            queryString = path.substr(pos + 1);
-        }
+    void authenticateNonPost(http::request<http::string_body>& req, const RequestBuilder& request) const {
+        const auto ts = serverClock.now();
+        const int receiveWindow = this->receiveWindow;
 
-        std::string parameterString;
+        RequestBuilder::SignaturePayload payload;
+        request.writeSignaturePayload(ts, apiKey, receiveWindow, payload);
 
-        const auto ts = getMsTimestamp(currentTime()).count();
-        parameterString.append(std::to_string(ts));
-        parameterString.append(apiKey);
-        parameterString.append(std::to_string(receiveWindow));
-        parameterString.append(queryString);
+        HMACSigner::Signature signature;
+        signer->sign(payload.view(), signature);
 
-        unsigned char digest[SHA256_DIGEST_LENGTH];
-        unsigned int digestLength = SHA256_DIGEST_LENGTH;
-
-        HMAC(evpMd, apiSecret.data(), static_cast<int>(apiSecret.size()), reinterpret_cast<const unsigned char*>(parameterString.data()), parameterString.length(), digest,
-             &digestLength);
-
-        const std::string signature = stringToHex(digest, sizeof(digest));
+        InlineBuffer<24> timestamp;
+        timestamp.append(ts);
+        InlineBuffer<24> window;
+        window.append(receiveWindow);
 
         req.set("X-BAPI-API-KEY", apiKey);
-        req.set("X-BAPI-SIGN", signature);
+        req.set("X-BAPI-SIGN", beast::string_view(signature.data(), signature.size()));
         req.set("X-BAPI-SIGN-TYPE", "2");
-        req.set("X-BAPI-TIMESTAMP", std::to_string(ts));
-        req.set("X-BAPI-RECV-WINDOW", std::to_string(receiveWindow));
+        req.set("X-BAPI-TIMESTAMP", beast::string_view(timestamp.view().data(), timestamp.size()));
+        req.set("X-BAPI-RECV-WINDOW", beast::string_view(window.view().data(), window.size()));
     }
 };
 
 HTTPSession::HTTPSession(const std::string& apiKey, const std::string& apiSecret) : m_p(std::make_unique<P>()) {
     m_p->uri = API_MAINNET_URI;
     m_p->apiKey = apiKey;
-    m_p->apiSecret = apiSecret;
+    m_p->signer = std::make_unique<HMACSigner>(apiSecret);
+
+    /// Off the order path, the first signed request usually finds the clock synchronized
+    if (!apiKey.empty()) {
+        m_p->startClockSync();
+    }
 }
 
-HTTPSession::~HTTPSession() = default;
+HTTPSession::~HTTPSession() {
+    /// A coroutine running on the IO thread may release the last reference, the thread cannot join itself. The IO
+    /// context is stopped and destroyed on another thread, after the running handler has returned.
+    if (m_p && std::this_thread::get_id() == m_p->ioThread.get_id()) {
+        std::thread([p = std::move(m_p)]() mutable { p.reset(); }).detach();
+    }
+}
 
-http::response<http::string_body> HTTPSession::get(const std::string& path, const std::map<std::string, std::string>& parameters) const {
-    std::string finalPath = path;
+http::response<http::string_body> HTTPSession::get(const RequestBuilder& request, const RequestOptions& options) const {
+    return net::co_spawn(m_p->ioc, getAsync(request, options), net::use_future).get();
+}
 
-    if (const auto queryString = P::createQueryStr(parameters); !queryString.empty()) {
-        finalPath.append("?");
-        finalPath.append(queryString);
-    }
+http::response<http::string_body> HTTPSession::post(const std::string& path, const nlohmann::json& json, const RequestOptions& options) const {
+    return net::co_spawn(m_p->ioc, postAsync(path, json, options), net::use_future).get();
+}
 
-    http::request<http::string_body> req{http::verb::get, finalPath, 11};
-    m_p->authenticateNonPost(req);
-    return m_p->request(req);
+net::awaitable<http::response<http::string_body>> HTTPSession::getAsync(const RequestBuilder& request, const RequestOptions& options) const {
+    const auto target = request.target();
+    http::request<http::string_body> req{http::verb::get, beast::string_view(target.data(), target.size()), 11};
+    co_return co_await m_p->request(std::move(req), [this, &request](http::request<http::string_body>& signedReq) {
+        m_p->authenticateNonPost(signedReq, request);
+    }, options);
 }
 
-http::response<http::string_body> HTTPSession::post(const std::string& path, const nlohmann::json& json) const {
+net::awaitable<http::response<http::string_body>> HTTPSession::postAsync(const std::string& path, const nlohmann::json& json, const RequestOptions& options) const {
     http::request<http::string_body> req{http::verb::post, path, 11};
-    m_p->authenticatePost(req, json);
-    return m_p->request(req);
+    co_return co_await m_p->request(std::move(req), [this, &json](http::request<http::string_body>& signedReq) {
+        m_p->authenticatePost(signedReq, json);
+    }, options);
+}
+
+net::any_io_executor HTTPSession::executor() const { return m_p->ioc.get_executor(); }
+
+bool HTTPSession::isIOThread() const { return std::this_thread::get_id() == m_p->ioThread.get_id(); }
+
+void HTTPSession::setReceiveWindow(const int receiveWindow) const { m_p->receiveWindow = receiveWindow; }
+
+int HTTPSession::receiveWindow() const { return m_p->receiveWindow; }
+
+const ServerClock& HTTPSession::serverClock() const { return m_p->serverClock; }
+
+void HTTPSession::P::onResponse(const http::response<http::string_body>& response, const std::int64_t sendTime, const std::int64_t receiveTime) {
+    /// Every response is a passive clock sample, the ms resolution and the processing time inflate the round trip,
+    /// so the /v5/market/time samples win the filtering when they are available
+    if (const auto it = response.find("Timenow"); it != response.end()) {
+        std::int64_t serverTime = 0;
+        const auto value = it->value();
+
+        if (const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), serverTime); ec == std::errc()) {
+            serverClock.addSample(sendTime, serverTime * 1000, receiveTime, true);
+        }
+    }
+
+    /// retCode 10002: the request timestamp is outside of the receive window, start over with a fresh estimate taken
+    /// in the background
+    static constexpr std::string_view TIMESTAMP_ERROR = R"({"retCode":10002,)";
+
+    if (std::string_view(response.body()).starts_with(TIMESTAMP_ERROR)) {
+        serverClock.reset();
+        startClockSync();
+    }
 }
 
-http::response<http::string_body> HTTPSession::P::request(http::request<http::string_body> req) {
+net::awaitable<http::response<http::string_body>> HTTPSession::P::request(http::request<http::string_body> req, const Authenticator& authenticate, const RequestOptions& options) {
     req.set(http::field::host, uri);
     req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    req.keep_alive(true);
+
+    const auto executor = co_await net::this_coro::executor;
+    const auto& deadlines = options.deadlines;
+    const CancellationScope cancellation(options.cancellationToken, executor);
+
+    for (int attempt = 0;; ++attempt) {
+        cancellation.check();
+        std::unique_ptr<Connection> connection;
+
+        try {
+            /// The retry dials a new connection, the other pooled ones may be as stale as the first one
+            connection = attempt == 0 ? co_await acquireConnection(executor, deadlines, cancellation) : co_await connect(executor, deadlines, cancellation);
+        } catch (...) {
+            /// The stream of the failed dial is gone
+            cancellation.bind(nullptr);
+            throw;
+        }
 
-    ssl::context ctx{ssl::context::sslv23_client};
-    ctx.set_default_verify_paths();
+        auto& tcpStream = beast::get_lowest_layer(connection->stream);
+        cancellation.bind(&tcpStream);
+        cancellation.check();
 
-    tcp::resolver resolver{ioc};
-    ssl::stream<tcp::socket> stream{ioc, ctx};
+        /// A retry gets a fresh timestamp and signature, the first attempt may have used up the receive window
+        if (authenticate) {
+            keepClockSynchronized();
+            authenticate(req);
+        }
 
-    // Set SNI Hostname (many hosts need this to handshake successfully)
-    if (!SSL_set_tlsext_host_name(stream.native_handle(), uri.c_str())) {
-        boost::system::error_code ec{static_cast<int>(ERR_get_error()), net::error::get_ssl_category()};
-        throw boost::system::system_error{ec};
-    }
+        const bool isReused = connection->numRequests > 0;
 
-    auto const results = resolver.resolve(uri, "443");
-    net::connect(stream.next_layer(), results.begin(), results.end());
-    stream.handshake(ssl::stream_base::client);
+        http::response<http::string_body> response;
+        beast::error_code ec;
+        std::size_t bytesRead = 0;
+        const auto sendTime = localTimeInUs();
 
-    http::write(stream, req);
-    beast::flat_buffer buffer;
-    http::response<http::string_body> response;
-    http::read(stream, buffer, response);
+        tcpStream.expires_after(deadlines.write);
+        co_await http::async_write(connection->stream, req, net::redirect_error(net::use_awaitable, ec));
+        const bool isWritten = !ec;
 
-    boost::system::error_code ec;
-    [[maybe_unused]] const auto rc = stream.shutdown(ec);
-    if (ec == boost::asio::error::eof) {
-        // Rationale:
-        // http://stackoverflow.com/questions/25587403/boost-asio-ssl-async-shutdown-always-finishes-with-an-error
-        ec.assign(0, ec.category());
-    }
+        if (isWritten) {
+            tcpStream.expires_after(deadlines.read);
+            bytesRead = co_await http::async_read(connection->stream, connection->buffer, response, net::redirect_error(net::use_awaitable, ec));
+        }
+
+        cancellation.bind(nullptr);
+        cancellation.check();
+
+        if (ec) {
+            /// The server may close an idle keep-alive connection at any time. A request whose write failed on a reused
+            /// connection never reached the server, so it is sent again on a new connection. A written request may
+            /// have been executed even if nothing came back, only a GET is idempotent enough to be sent again.
+            /// A timed out request may have reached the server, it is up to the caller to retry it.
+            const bool isUnanswered = bytesRead == 0 && connection->buffer.size() == 0;
 
-    return response;
+            if (isReused && attempt == 0 && ec != beast::error::timeout && (!isWritten || (req.method() == http::verb::get && isUnanswered))) {
+                continue;
+            }
+
+            throw boost::system::system_error{ec};
+        }
+
+        tcpStream.expires_never();
+        connection->numRequests++;
+        releaseConnection(std::move(connection), response.keep_alive());
+        onResponse(response, sendTime, localTimeInUs());
+        co_return response;
+    }
 }
 } // namespace vk::bybit
@@ -0,0 +1,257 @@
+/**
+Bybit Instrument Cache
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_instrument_cache.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+
+namespace vk::bybit {
+static constexpr std::uint32_t MAGIC = 0x49425956; // "VYBI"
+/// Upper bound of string lengths, a bigger one means a damaged file
+static constexpr std::uint32_t MAX_STRING_LENGTH = 1024;
+
+static std::uint64_t checksum(const std::string_view data) {
+    std::uint64_t retVal = 0xcbf29ce484222325;
+
+    for (const auto c: data) {
+        retVal ^= static_cast<std::uint8_t>(c);
+        retVal *= 0x100000001b3;
+    }
+
+    return retVal;
+}
+
+class Writer {
+    std::string m_buffer;
+
+public:
+    template<typename ValueType>
+    void write(const ValueType value) {
+        static_assert(std::is_trivially_copyable_v<ValueType>);
+        m_buffer.append(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+    }
+
+    void write(const std::string& value) {
+        write(static_cast<std::uint32_t>(value.size()));
+        m_buffer.append(value);
+    }
+
+    [[nodiscard]] const std::string& buffer() const {
+        return m_buffer;
+    }
+};
+
+/**
+ * Reads values from the buffer, every read fails instead of running past the end
+ */
+class Reader {
+    std::string_view m_data;
+
+public:
+    explicit Reader(const std::string_view data) : m_data(data) {}
+
+    template<typename ValueType>
+    [[nodiscard]] bool read(ValueType& value) {
+        static_assert(std::is_trivially_copyable_v<ValueType>);
+
+        if (m_data.size() < sizeof(ValueType)) {
+            return false;
+        }
+
+        std::memcpy(&value, m_data.data(), sizeof(ValueType));
+        m_data.remove_prefix(sizeof(ValueType));
+        return true;
+    }
+
+    [[nodiscard]] bool read(std::string& value) {
+        std::uint32_t length = 0;
+
+        if (!read(length) || length > MAX_STRING_LENGTH || m_data.size() < length) {
+            return false;
+        }
+
+        value.assign(m_data.substr(0, length));
+        m_data.remove_prefix(length);
+        return true;
+    }
+
+    template<typename EnumType>
+    [[nodiscard]] bool readEnum(EnumType& value) {
+        std::int32_t raw = 0;
+
+        if (!read(raw) || !magic_enum::enum_cast<EnumType>(raw)) {
+            return false;
+        }
+
+        value = static_cast<EnumType>(raw);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return m_data.empty();
+    }
+};
+
+static void writeInstrument(Writer& writer, const Instrument& instrument) {
+    writer.write(instrument.symbol);
+    writer.write(static_cast<std::int32_t>(instrument.contractType));
+    writer.write(static_cast<std::int32_t>(instrument.contractStatus));
+    writer.write(instrument.baseCoin);
+    writer.write(instrument.quoteCoin);
+    writer.write(instrument.launchTime);
+    writer.write(instrument.deliveryTime);
+    writer.write(instrument.deliveryFeeRate);
+    writer.write(static_cast<std::int32_t>(instrument.priceScale));
+    writer.write(static_cast<std::uint8_t>(instrument.unifiedMarginTrade));
+    writer.write(static_cast<std::int32_t>(instrument.fundingInterval));
+    writer.write(instrument.settleCoin);
+    writer.write(instrument.leverageFilter.minLeverage);
+    writer.write(instrument.leverageFilter.maxLeverage);
+    writer.write(instrument.leverageFilter.leverageStep);
+    writer.write(instrument.priceFilter.minPrice);
+    writer.write(instrument.priceFilter.maxPrice);
+    writer.write(instrument.priceFilter.tickSize);
+    writer.write(instrument.lotSizeFilter.maxOrderQty);
+    writer.write(instrument.lotSizeFilter.minOrderQty);
+    writer.write(instrument.lotSizeFilter.qtyStep);
+    writer.write(instrument.lotSizeFilter.postOnlyMaxTradingQty);
+}
+
+static bool readInstrument(Reader& reader, Instrument& instrument) {
+    std::int32_t priceScale = 0;
+    std::uint8_t unifiedMarginTrade = 0;
+    std::int32_t fundingInterval = 0;
+
+    const auto ok = reader.read(instrument.symbol) &&
+                    reader.readEnum(instrument.contractType) &&
+                    reader.readEnum(instrument.contractStatus) &&
+                    reader.read(instrument.baseCoin) &&
+                    reader.read(instrument.quoteCoin) &&
+                    reader.read(instrument.launchTime) &&
+                    reader.read(instrument.deliveryTime) &&
+                    reader.read(instrument.deliveryFeeRate) &&
+                    reader.read(priceScale) &&
+                    reader.read(unifiedMarginTrade) &&
+                    reader.read(fundingInterval) &&
+                    reader.read(instrument.settleCoin) &&
+                    reader.read(instrument.leverageFilter.minLeverage) &&
+                    reader.read(instrument.leverageFilter.maxLeverage) &&
+                    reader.read(instrument.leverageFilter.leverageStep) &&
+                    reader.read(instrument.priceFilter.minPrice) &&
+                    reader.read(instrument.priceFilter.maxPrice) &&
+                    reader.read(instrument.priceFilter.tickSize) &&
+                    reader.read(instrument.lotSizeFilter.maxOrderQty) &&
+                    reader.read(instrument.lotSizeFilter.minOrderQty) &&
+                    reader.read(instrument.lotSizeFilter.qtyStep) &&
+                    reader.read(instrument.lotSizeFilter.postOnlyMaxTradingQty);
+
+    instrument.priceScale = priceScale;
+    instrument.unifiedMarginTrade = unifiedMarginTrade != 0;
+    instrument.fundingInterval = fundingInterval;
+    return ok;
+}
+
+InstrumentCacheFile::InstrumentCacheFile(std::filesystem::path path) : m_path(std::move(path)) {}
+
+std::optional<InstrumentCacheContent> InstrumentCacheFile::load() const {
+    std::ifstream file(m_path, std::ios::binary);
+
+    if (!file) {
+        return std::nullopt;
+    }
+
+    const std::string data{std::istreambuf_iterator(file), std::istreambuf_iterator<char>()};
+
+    if (data.size() < sizeof(std::uint64_t)) {
+        return std::nullopt;
+    }
+
+    /// The checksum of everything before it is the last field
+    const auto payload = std::string_view(data).substr(0, data.size() - sizeof(std::uint64_t));
+    std::uint64_t storedChecksum = 0;
+    std::memcpy(&storedChecksum, data.data() + payload.size(), sizeof(storedChecksum));
+
+    if (storedChecksum != checksum(payload)) {
+        return std::nullopt;
+    }
+
+    Reader reader(payload);
+    std::uint32_t magic = 0;
+    std::uint32_t version = 0;
+    std::uint32_t numCategories = 0;
+    InstrumentCacheContent retVal;
+
+    if (!reader.read(magic) || magic != MAGIC || !reader.read(version) || version != VERSION || !reader.read(numCategories)) {
+        return std::nullopt;
+    }
+
+    for (std::uint32_t i = 0; i < numCategories; ++i) {
+        Category category{};
+        std::int64_t timestamp = 0;
+        std::uint32_t numInstruments = 0;
+
+        if (!reader.readEnum(category) || !reader.read(timestamp) || !reader.read(numInstruments)) {
+            return std::nullopt;
+        }
+
+        auto& cached = retVal.categories[category];
+        cached.timestamp = timestamp;
+        auto& instruments = cached.instruments;
+
+        for (std::uint32_t j = 0; j < numInstruments; ++j) {
+            if (!readInstrument(reader, instruments.emplace_back())) {
+                return std::nullopt;
+            }
+        }
+    }
+
+    if (!reader.empty()) {
+        return std::nullopt;
+    }
+
+    return retVal;
+}
+
+void InstrumentCacheFile::save(const InstrumentCacheContent& content) const {
+    Writer writer;
+    writer.write(MAGIC);
+    writer.write(VERSION);
+    writer.write(static_cast<std::uint32_t>(content.categories.size()));
+
+    for (const auto& [category, cached]: content.categories) {
+        writer.write(static_cast<std::int32_t>(category));
+        writer.write(cached.timestamp);
+        writer.write(static_cast<std::uint32_t>(cached.instruments.size()));
+
+        for (const auto& instrument: cached.instruments) {
+            writeInstrument(writer, instrument);
+        }
+    }
+
+    writer.write(checksum(writer.buffer()));
+
+    auto tmpPath = m_path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(writer.buffer().data(), static_cast<std::streamsize>(writer.buffer().size()));
+
+        if (!file.flush()) {
+            throw std::runtime_error("Could not write instrument cache: " + tmpPath.string());
+        }
+    }
+
+    std::filesystem::rename(tmpPath, m_path);
+}
+
+const std::filesystem::path& InstrumentCacheFile::path() const {
+    return m_path;
+}
+} // namespace vk::bybit
@@ -0,0 +1,205 @@
+/**
+Bybit JSON View
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_json_view.h"
+#include <charconv>
+#include <stdexcept>
+
+namespace vk::bybit {
+[[noreturn]] static void throwMalformed() {
+    throw std::runtime_error("Malformed JSON");
+}
+
+static bool isWhitespace(const char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static std::size_t skipWhitespace(const std::string_view json, std::size_t pos) {
+    while (pos < json.size() && isWhitespace(json[pos])) {
+        ++pos;
+    }
+
+    return pos;
+}
+
+/**
+ * @param pos position of the opening quote
+ * @return position after the closing quote
+ */
+static std::size_t skipString(const std::string_view json, std::size_t pos) {
+    for (++pos; pos < json.size(); ++pos) {
+        if (json[pos] == '\\') {
+            ++pos;
+        } else if (json[pos] == '"') {
+            return pos + 1;
+        }
+    }
+
+    throwMalformed();
+}
+
+/**
+ * @param pos position of the first character of the value
+ * @return position after the value
+ */
+static std::size_t skipValue(const std::string_view json, std::size_t pos) {
+    if (pos >= json.size()) {
+        throwMalformed();
+    }
+
+    switch (json[pos]) {
+    case '"':
+        return skipString(json, pos);
+    case '{':
+    case '[': {
+        int depth = 0;
+
+        while (pos < json.size()) {
+            switch (json[pos]) {
+            case '"':
+                pos = skipString(json, pos);
+                continue;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    return pos + 1;
+                }
+                break;
+            default:
+                break;
+            }
+
+            ++pos;
+        }
+
+        throwMalformed();
+    }
+    default:
+        while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' && !isWhitespace(json[pos])) {
+            ++pos;
+        }
+
+        return pos;
+    }
+}
+
+JsonView::Iterator::Iterator(const std::string_view elements, const bool isObject) : m_rest(elements), m_isObject(isObject) {
+    next();
+}
+
+void JsonView::Iterator::next() {
+    auto pos = skipWhitespace(m_rest, 0);
+
+    if (pos >= m_rest.size() || m_rest[pos] == ']' || m_rest[pos] == '}') {
+        m_key = {};
+        m_value = {};
+        return;
+    }
+
+    if (m_isObject) {
+        if (m_rest[pos] != '"') {
+            throwMalformed();
+        }
+
+        const auto keyEnd = skipString(m_rest, pos);
+        m_key = m_rest.substr(pos + 1, keyEnd - pos - 2);
+        pos = skipWhitespace(m_rest, keyEnd);
+
+        if (pos >= m_rest.size() || m_rest[pos] != ':') {
+            throwMalformed();
+        }
+
+        pos = skipWhitespace(m_rest, pos + 1);
+    }
+
+    const auto end = skipValue(m_rest, pos);
+    m_value = m_rest.substr(pos, end - pos);
+    pos = skipWhitespace(m_rest, end);
+
+    if (pos < m_rest.size() && m_rest[pos] == ',') {
+        ++pos;
+    }
+
+    m_rest = m_rest.substr(pos);
+}
+
+JsonView::JsonView(const std::string_view json) {
+    const auto first = skipWhitespace(json, 0);
+    auto last = json.size();
+
+    while (last > first && isWhitespace(json[last - 1])) {
+        --last;
+    }
+
+    m_json = json.substr(first, last - first);
+}
+
+JsonView JsonView::operator[](const std::string_view key) const {
+    if (!isObject()) {
+        return {};
+    }
+
+    for (auto it = begin(); it != end(); ++it) {
+        if (it.key() == key) {
+            return *it;
+        }
+    }
+
+    return {};
+}
+
+std::string_view JsonView::asString() const {
+    return isString() && m_json.size() >= 2 ? m_json.substr(1, m_json.size() - 2) : m_json;
+}
+
+double JsonView::asDouble(const double defaultValue) const {
+    const auto value = asString();
+    double retVal = 0.0;
+
+    if (const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), retVal); value.empty() || ec != std::errc{}) {
+        return defaultValue;
+    }
+
+    return retVal;
+}
+
+std::int64_t JsonView::asInt64(const std::int64_t defaultValue) const {
+    const auto value = asString();
+    std::int64_t retVal = 0;
+
+    if (const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), retVal); value.empty() || ec != std::errc{}) {
+        return defaultValue;
+    }
+
+    return retVal;
+}
+
+bool JsonView::asBool(const bool defaultValue) const {
+    if (m_json == "true") {
+        return true;
+    }
+
+    if (m_json == "false") {
+        return false;
+    }
+
+    return defaultValue;
+}
+
+JsonView::Iterator JsonView::begin() const {
+    return isArray() || isObject() ? Iterator(m_json.substr(1), isObject()) : end();
+}
+
+JsonView::Iterator JsonView::end() const {
+    return {};
+}
+} // namespace vk::bybit
@@ -0,0 +1,146 @@
+/**
+Bybit Order Book
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_order_book.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace vk::bybit {
+static OrderBookLevel readLevel(const JsonView& json) {
+    /// ["price", "size"]
+    auto it = json.begin();
+
+    if (it == json.end()) {
+        throw std::runtime_error("Malformed order book level");
+    }
+
+    OrderBookLevel retVal;
+    retVal.price = (*it).asDouble();
+
+    if (++it == json.end()) {
+        throw std::runtime_error("Malformed order book level");
+    }
+
+    retVal.size = (*it).asDouble();
+    return retVal;
+}
+
+/**
+ * Levels are sorted by the comparator with the best price at the back
+ */
+template<typename Compare>
+static void applyLevel(std::vector<OrderBookLevel>& levels, const OrderBookLevel& level, const Compare compare) {
+    const auto it = std::lower_bound(levels.begin(), levels.end(), level.price, [compare](const OrderBookLevel& lhs, const double price) {
+        return compare(lhs.price, price);
+    });
+
+    if (it != levels.end() && it->price == level.price) {
+        if (level.size == 0.0) {
+            levels.erase(it);
+        } else {
+            it->size = level.size;
+        }
+    } else if (level.size != 0.0) {
+        levels.insert(it, level);
+    }
+}
+
+template<typename Compare>
+static void loadSnapshot(std::vector<OrderBookLevel>& levels, const JsonView& json, const Compare compare) {
+    levels.clear();
+
+    for (const auto& level: json) {
+        if (auto value = readLevel(level); value.size != 0.0) {
+            levels.push_back(value);
+        }
+    }
+
+    /// The snapshot lists the best price first
+    std::reverse(levels.begin(), levels.end());
+
+    if (!std::is_sorted(levels.begin(), levels.end(), [compare](const OrderBookLevel& lhs, const OrderBookLevel& rhs) {
+            return compare(lhs.price, rhs.price);
+        })) {
+        std::sort(levels.begin(), levels.end(), [compare](const OrderBookLevel& lhs, const OrderBookLevel& rhs) {
+            return compare(lhs.price, rhs.price);
+        });
+    }
+}
+
+OrderBookUpdate OrderBook::update(const EventView& event) {
+    JsonView bids;
+    JsonView asks;
+    std::int64_t updateId = 0;
+    std::int64_t seq = 0;
+
+    for (auto it = event.data.begin(); it != event.data.end(); ++it) {
+        if (const auto key = it.key(); key == "b") {
+            bids = *it;
+        } else if (key == "a") {
+            asks = *it;
+        } else if (key == "u") {
+            updateId = (*it).asInt64();
+        } else if (key == "seq") {
+            seq = (*it).asInt64();
+        }
+    }
+
+    if (event.type == ResponseType::snapshot) {
+        loadSnapshot(m_bids, bids, std::less<>());
+        loadSnapshot(m_asks, asks, std::greater<>());
+        m_synchronized = true;
+    } else {
+        if (!m_synchronized || updateId <= m_updateId) {
+            return OrderBookUpdate::Ignored;
+        }
+
+        if (updateId != m_updateId + 1) {
+            reset();
+            return OrderBookUpdate::Gap;
+        }
+
+        for (const auto& level: bids) {
+            applyLevel(m_bids, readLevel(level), std::less<>());
+        }
+
+        for (const auto& level: asks) {
+            applyLevel(m_asks, readLevel(level), std::greater<>());
+        }
+    }
+
+    m_ts = event.ts;
+    m_updateId = updateId;
+    m_seq = seq;
+    return OrderBookUpdate::Applied;
+}
+
+void OrderBook::reset() {
+    m_bids.clear();
+    m_asks.clear();
+    m_synchronized = false;
+}
+
+void OrderBook::top(EventOrderBook& event, std::size_t numLevels) const {
+    numLevels = std::min(numLevels, EventOrderBook::MAX_LEVELS);
+    event.ts = m_ts;
+    event.updateId = m_updateId;
+    event.seq = m_seq;
+    event.synchronized = m_synchronized;
+    event.numBids = std::min(m_bids.size(), numLevels);
+    event.numAsks = std::min(m_asks.size(), numLevels);
+
+    for (std::size_t i = 0; i < event.numBids; ++i) {
+        event.levels[i].bid = bid(i);
+    }
+
+    for (std::size_t i = 0; i < event.numAsks; ++i) {
+        event.levels[i].ask = ask(i);
+    }
+}
+} // namespace vk::bybit
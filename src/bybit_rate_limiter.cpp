@@ -0,0 +1,500 @@
+/**
+Bybit Rate Limiter
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_rate_limiter.h"
+#include <boost/asio/post.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ranges>
+
+namespace vk::bybit {
+namespace bip = boost::interprocess;
+using Clock = std::chrono::steady_clock;
+
+/// Tokens left to other processes using the same API key, the server counts all of them
+static constexpr std::int64_t SERVER_TOKEN_RESERVE = 2;
+/// Added to the server reset time to absorb the clock difference
+static constexpr int RESET_MARGIN_IN_MS = 50;
+/// Bybit allows 600 requests per 5 s from one IP address over all endpoints
+static constexpr std::int64_t IP_REQUESTS_PER_SECOND = 120;
+/// Slot of the IP address bucket in the shared memory table, endpoint groups start with a slash
+static constexpr std::string_view IP_GROUP = "ip";
+
+static std::optional<std::int64_t> readHeader(const boost::beast::http::fields& fields, const std::string_view name) {
+    const auto it = fields.find(boost::beast::string_view(name.data(), name.size()));
+
+    if (it == fields.end()) {
+        return std::nullopt;
+    }
+
+    std::int64_t value = 0;
+    const auto str = it->value();
+
+    if (const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value); ec != std::errc()) {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+/**
+ * Token bucket as a GCRA (generic cell rate algorithm): the whole state is the theoretical arrival time of the next
+ * request, so a token is taken by a single CAS. All values are in ns of the steady clock, which is CLOCK_MONOTONIC
+ * and so comparable across processes. The structure lives either in the process or in the shared memory, zero bytes
+ * are a valid state of a free slot.
+ */
+struct BucketState {
+    std::atomic<std::uint64_t> groupHash;
+    std::atomic<std::int64_t> capacity;
+    std::atomic<std::int64_t> emissionInterval;
+    std::atomic<std::int64_t> theoreticalArrival;
+    std::atomic<std::int64_t> blockedUntil;
+    std::atomic<std::int64_t> isServerLimitKnown;
+
+    static_assert(std::atomic<std::int64_t>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free);
+
+    void setLimit(const std::int64_t requestsPerSecond) {
+        capacity = requestsPerSecond;
+        emissionInterval = 1'000'000'000 / requestsPerSecond;
+    }
+
+    /**
+     * Take a token
+     * @param now in ns
+     * @param defaultRequestsPerSecond used when the slot was claimed by another process which did not set it yet
+     * @return 0 if the token was taken, otherwise the time of the next token in ns
+     */
+    std::int64_t tryTake(const std::int64_t now, const std::int64_t defaultRequestsPerSecond) {
+        if (const auto blocked = blockedUntil.load(); now < blocked) {
+            return blocked;
+        }
+
+        const auto interval = emissionInterval.load();
+        const auto limit = capacity.load();
+        const auto emission = interval > 0 ? interval : 1'000'000'000 / defaultRequestsPerSecond;
+        const auto burst = (limit > 0 ? limit : defaultRequestsPerSecond) * emission;
+        auto arrival = theoreticalArrival.load();
+
+        for (;;) {
+            const auto nextArrival = std::max(arrival, now) + emission;
+
+            if (nextArrival - now > burst) {
+                return nextArrival - burst;
+            }
+
+            if (theoreticalArrival.compare_exchange_weak(arrival, nextArrival)) {
+                return 0;
+            }
+        }
+    }
+
+    /**
+     * Lower the number of available tokens to the server state, tokens are never added
+     * @param available tokens
+     * @param now in ns
+     */
+    void limitAvailable(const std::int64_t available, const std::int64_t now) {
+        if (const auto emission = emissionInterval.load(); emission > 0) {
+            raise(theoreticalArrival, now + (capacity.load() - available) * emission);
+        }
+    }
+
+    /**
+     * Block the bucket until the reset, the whole capacity is available after it
+     * @param resetTime in ns
+     */
+    void blockUntil(const std::int64_t resetTime) {
+        raise(blockedUntil, resetTime);
+        raise(theoreticalArrival, resetTime);
+    }
+
+    static void raise(std::atomic<std::int64_t>& value, const std::int64_t newValue) {
+        auto current = value.load();
+
+        while (current < newValue && !value.compare_exchange_weak(current, newValue)) {
+        }
+    }
+};
+
+static std::int64_t steadyTimeInNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/// FNV-1a, stable across processes and builds unlike std::hash
+static std::uint64_t stableHash(const std::string_view str) {
+    std::uint64_t hash = 14695981039346656037ULL;
+
+    for (const auto c: str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash == 0 ? 1 : hash;
+}
+
+/**
+ * Table of bucket states in a POSIX shared memory segment, slots are claimed by CAS of the group hash with linear
+ * probing and never released
+ */
+class SharedBuckets {
+    static constexpr std::uint64_t MAGIC = 0x766b62796269746cULL;
+
+    struct Layout {
+        std::atomic<std::uint64_t> magic;
+        BucketState slots[RateLimiter::MAX_SHARED_GROUPS];
+    };
+
+    bip::shared_memory_object m_segment;
+    bip::mapped_region m_region;
+    Layout* m_layout = nullptr;
+
+public:
+    explicit SharedBuckets(const std::string& name) : m_segment(bip::open_or_create, name.c_str(), bip::read_write) {
+        /// A new segment is zero filled, zero is a valid state, so no process has to initialize it
+        if (bip::offset_t size = 0; !m_segment.get_size(size) || size < static_cast<bip::offset_t>(sizeof(Layout))) {
+            m_segment.truncate(sizeof(Layout));
+        }
+
+        m_region = bip::mapped_region(m_segment, bip::read_write, 0, sizeof(Layout));
+        m_layout = static_cast<Layout*>(m_region.get_address());
+
+        std::uint64_t magic = 0;
+        m_layout->magic.compare_exchange_strong(magic, MAGIC);
+
+        if (m_layout->magic.load() != MAGIC) {
+            throw std::runtime_error("Incompatible rate limit segment: " + name);
+        }
+    }
+
+    /**
+     * Find or claim the slot of the group
+     * @param isClaimed set to true if the slot was claimed by this call
+     * @return slot, nullptr if the table is full
+     */
+    BucketState* find(const std::string_view group, bool& isClaimed) const {
+        const auto hash = stableHash(group);
+        isClaimed = false;
+
+        for (std::size_t i = 0; i < RateLimiter::MAX_SHARED_GROUPS; ++i) {
+            auto& slot = m_layout->slots[(hash + i) % RateLimiter::MAX_SHARED_GROUPS];
+            auto slotHash = slot.groupHash.load();
+
+            if (slotHash == 0 && slot.groupHash.compare_exchange_strong(slotHash, hash)) {
+                isClaimed = true;
+                return &slot;
+            }
+
+            if (slotHash == hash) {
+                return &slot;
+            }
+        }
+
+        return nullptr;
+    }
+};
+
+struct RateLimiter::P {
+    struct Waiter {
+        net::steady_timer timer;
+
+        explicit Waiter(const net::any_io_executor& executor) : timer(executor) {}
+    };
+
+    struct Bucket {
+        BucketState localState{};
+        BucketState* state = &localState;
+        std::int64_t nextTokenTime = 0;
+        std::array<std::deque<std::shared_ptr<Waiter>>, 3> lanes;
+
+        bool tryTake(const std::int64_t defaultRequestsPerSecond) {
+            nextTokenTime = state->tryTake(steadyTimeInNs(), defaultRequestsPerSecond);
+            return nextTokenTime == 0;
+        }
+
+        /**
+         * Check there is no request waiting with the same or a higher priority
+         */
+        [[nodiscard]] bool isFree(const RequestPriority priority) const {
+            for (std::size_t i = 0; i <= static_cast<std::size_t>(priority); ++i) {
+                if (!lanes[i].empty()) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        [[nodiscard]] Waiter* head() const {
+            for (const auto& lane: lanes) {
+                if (!lane.empty()) {
+                    return lane.front().get();
+                }
+            }
+
+            return nullptr;
+        }
+
+        /**
+         * Wake up the first waiter to re-evaluate its waiting time, the timer is touched only on its own executor
+         */
+        void notifyHead() const {
+            for (const auto& lane: lanes) {
+                if (!lane.empty()) {
+                    net::post(lane.front()->timer.get_executor(), [waiter = lane.front()] { waiter->timer.cancel(); });
+                    return;
+                }
+            }
+        }
+
+        bool remove(const Waiter* waiter) {
+            for (auto& lane: lanes) {
+                if (const auto it = std::ranges::find(lane, waiter, &std::shared_ptr<Waiter>::get); it != lane.end()) {
+                    lane.erase(it);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    /**
+     * Removes the waiter from the queue if its coroutine is destroyed before it got the token
+     */
+    struct WaiterGuard {
+        P* p = nullptr;
+        Bucket* bucket = nullptr;
+        const Waiter* waiter = nullptr;
+
+        WaiterGuard(P* p, Bucket* bucket, const Waiter* waiter) : p(p), bucket(bucket), waiter(waiter) {}
+
+        WaiterGuard(const WaiterGuard&) = delete;
+
+        WaiterGuard& operator=(const WaiterGuard&) = delete;
+
+        ~WaiterGuard() {
+            if (!waiter) {
+                return;
+            }
+
+            std::lock_guard lk(p->locker);
+            const bool wasHead = bucket->head() == waiter;
+
+            if (bucket->remove(waiter)) {
+                --p->numWaiting;
+            }
+
+            if (wasHead) {
+                bucket->notifyHead();
+            }
+        }
+    };
+
+    mutable std::mutex locker;
+    std::map<std::string, Bucket, std::less<>> buckets;
+    /// Limit of the IP address taken by every request after the token of its group
+    Bucket ipBucket;
+    std::unique_ptr<SharedBuckets> sharedBuckets;
+    std::int32_t defaultRequestsPerSecond = DEFAULT_REQUESTS_PER_SECOND;
+    std::size_t numWaiting = 0;
+
+    P() {
+        ipBucket.localState.setLimit(IP_REQUESTS_PER_SECOND);
+        ipBucket.localState.isServerLimitKnown = 1;
+    }
+
+    /**
+     * Point the bucket to its slot in the shared table, it keeps the local state when the table is full
+     * @return true if the slot was claimed by this process, its limit is not set yet
+     */
+    bool attach(const std::string_view group, Bucket& bucket) const {
+        if (!sharedBuckets) {
+            return false;
+        }
+
+        bool isClaimed = false;
+
+        if (const auto state = sharedBuckets->find(group, isClaimed)) {
+            bucket.state = state;
+        }
+
+        return isClaimed;
+    }
+
+    Bucket& bucket(const std::string_view group) {
+        if (const auto it = buckets.find(group); it != buckets.end()) {
+            return it->second;
+        }
+
+        auto& retVal = buckets[std::string(group)];
+        retVal.localState.setLimit(defaultRequestsPerSecond);
+        attach(group, retVal);
+        return retVal;
+    }
+
+    /**
+     * Take a token from the bucket, waits in the lane of the priority when the bucket is empty or requests of the same
+     * or a higher priority wait
+     */
+    net::awaitable<void> take(Bucket& bucket, const RequestPriority priority) {
+        const auto executor = co_await net::this_coro::executor;
+        std::shared_ptr<Waiter> waiter;
+        {
+            std::lock_guard lk(locker);
+
+            if (bucket.isFree(priority) && bucket.tryTake(defaultRequestsPerSecond)) {
+                co_return;
+            }
+
+            waiter = std::make_shared<Waiter>(executor);
+            bucket.lanes[static_cast<std::size_t>(priority)].push_back(waiter);
+            ++numWaiting;
+        }
+
+        WaiterGuard guard(this, &bucket, waiter.get());
+
+        for (;;) {
+            auto wakeUpTime = Clock::time_point::max();
+            {
+                std::lock_guard lk(locker);
+
+                if (bucket.head() == waiter.get()) {
+                    if (bucket.tryTake(defaultRequestsPerSecond)) {
+                        bucket.remove(waiter.get());
+                        --numWaiting;
+                        bucket.notifyHead();
+                        guard.waiter = nullptr;
+                        co_return;
+                    }
+
+                    wakeUpTime = Clock::time_point(std::chrono::nanoseconds(bucket.nextTokenTime));
+                }
+            }
+
+            /// Woken up either by the timer or by notifyHead(), the state is re-evaluated in both cases
+            boost::system::error_code ec;
+            waiter->timer.expires_at(wakeUpTime);
+            co_await waiter->timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+        }
+    }
+};
+
+RateLimiter::RateLimiter() : m_p(std::make_unique<P>()) {}
+
+RateLimiter::~RateLimiter() = default;
+
+net::awaitable<void> RateLimiter::acquire(const std::string_view group, const RequestPriority priority) const {
+    P::Bucket* bucket = nullptr;
+    {
+        std::lock_guard lk(m_p->locker);
+        bucket = &m_p->bucket(group);
+    }
+
+    co_await m_p->take(*bucket, priority);
+    /// Every endpoint group maps to one priority, the lanes reorder requests of different groups here
+    co_await m_p->take(m_p->ipBucket, priority);
+}
+
+void RateLimiter::update(const std::string_view group, const boost::beast::http::fields& fields) const {
+    const auto remaining = readHeader(fields, "X-Bapi-Limit-Status");
+
+    if (!remaining) {
+        return;
+    }
+
+    const auto limit = readHeader(fields, "X-Bapi-Limit");
+    auto resetTime = readHeader(fields, "X-Bapi-Limit-Reset-Timestamp");
+
+    if (!resetTime) {
+        resetTime = readHeader(fields, "X-Bapi-Limit-Reset");
+    }
+
+    std::lock_guard lk(m_p->locker);
+    auto& bucket = m_p->bucket(group);
+    auto& state = *bucket.state;
+    const auto now = steadyTimeInNs();
+
+    if (limit && *limit > 0) {
+        state.setLimit(*limit);
+        state.isServerLimitKnown = 1;
+    }
+
+    /// The server state only lowers the local estimate, tokens granted meanwhile are not counted by the server yet
+    const auto available = std::max<std::int64_t>(0, *remaining - SERVER_TOKEN_RESERVE);
+    state.limitAvailable(available, now);
+
+    if (available == 0 && resetTime) {
+        const auto systemNow = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+        if (*resetTime > systemNow) {
+            state.blockUntil(now + (*resetTime - systemNow + RESET_MARGIN_IN_MS) * 1'000'000);
+        }
+    }
+
+    bucket.notifyHead();
+}
+
+void RateLimiter::setDefaultLimit(const std::int32_t requestsPerSecond) const {
+    std::lock_guard lk(m_p->locker);
+    m_p->defaultRequestsPerSecond = requestsPerSecond;
+
+    for (auto& bucket: m_p->buckets | std::views::values) {
+        if (!bucket.state->isServerLimitKnown) {
+            bucket.state->setLimit(requestsPerSecond);
+            bucket.notifyHead();
+        }
+    }
+}
+
+void RateLimiter::shareBudget(const std::string& name) const {
+    auto sharedBuckets = std::make_unique<SharedBuckets>(name);
+
+    std::lock_guard lk(m_p->locker);
+
+    /// The previous segment is unmapped by the swap, no bucket may point into it then, a bucket without a slot in the
+    /// new table keeps the local state
+    for (auto& bucket: m_p->buckets | std::views::values) {
+        bucket.state = &bucket.localState;
+    }
+
+    m_p->ipBucket.state = &m_p->ipBucket.localState;
+    m_p->sharedBuckets = std::move(sharedBuckets);
+
+    for (auto& [group, bucket]: m_p->buckets) {
+        m_p->attach(group, bucket);
+    }
+
+    /// The processes run on the same host, so they share the IP address limit too. Only the process claiming the slot
+    /// sets its limit, the others would reset the state in use.
+    if (m_p->attach(IP_GROUP, m_p->ipBucket)) {
+        m_p->ipBucket.state->setLimit(IP_REQUESTS_PER_SECOND);
+        m_p->ipBucket.state->isServerLimitKnown = 1;
+    }
+}
+
+void RateLimiter::removeSharedBudget(const std::string& name) {
+    bip::shared_memory_object::remove(name.c_str());
+}
+
+std::size_t RateLimiter::numWaiting() const {
+    std::lock_guard lk(m_p->locker);
+    return m_p->numWaiting;
+}
+} // namespace vk::bybit
@@ -8,11 +8,27 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 
 #include "vk/bybit/bybit_rest_client.h"
 #include "vk/bybit/bybit_http_session.h"
+#include "vk/bybit/bybit_instrument_cache.h"
+#include "vk/bybit/bybit_rate_limiter.h"
 #include "vk/bybit/bybit.h"
 #include "vk/utils/utils.h"
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/use_future.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
+#include <map>
 #include <mutex>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
-#include <deque>
 
 namespace vk::bybit {
 template<typename ValueType>
@@ -28,131 +44,351 @@ ValueType handleBybitResponse(const http::response<http::string_body> &response)
 	return retVal;
 }
 
-struct RateLimiter {
-	std::mutex mutex;
-	int remaining = 50;
-	std::int64_t resetTime = 0;
-    
-    // Local fallback mechanism
-    bool serverHeadersFound = false;
-    std::deque<std::int64_t> requestTimes; // For local sliding window
-    const size_t localLimit = 10;           // 10 requests per second (conservative, Bybit doesn't send rate headers for public endpoints)
-    const std::int64_t windowSizeMs = 1000;
+static constexpr std::int32_t MAX_CANDLES_PER_PAGE = 1000;
+static constexpr std::int32_t MAX_FUNDING_RATES_PER_PAGE = 200;
+static constexpr std::size_t MAX_CONCURRENT_FUNDING_REQUESTS = 4;
+
+static RequestPriority requestPriority(const EndpointClass endpointClass) {
+	switch (endpointClass) {
+	case EndpointClass::Trade:
+		return RequestPriority::High;
+	case EndpointClass::History:
+		return RequestPriority::Low;
+	default:
+		return RequestPriority::Normal;
+	}
+}
 
-	void update(const http::response<http::string_body> &response) {
-		std::lock_guard lock(mutex);
-		try {
-			// Headers are case-insensitive in Boost.Beast
-			const auto itStatus = response.find("X-Bapi-Limit-Status");
-
-			if (const auto itReset = response.find("X-Bapi-Limit-Reset"); itStatus != response.end() && itReset != response.end()) {
-                remaining = std::stoi(std::string(itStatus->value()));
-                resetTime = std::stoll(std::string(itReset->value()));
-                serverHeadersFound = true; // Switch to server-side mode
-            }
-			
-			// Log for debugging
-#ifdef VERBOSE_LOG
-			spdlog::debug(fmt::format("RateLimit: Remaining={}, ResetTime={}, LocalMode={}", remaining, resetTime, !serverHeadersFound));
-#endif
-		} catch (const std::exception& e) {
-			spdlog::warn(fmt::format("Failed to parse rate limit headers: {}", e.what()));
-		}
-	}
-
-	void wait() {
-		std::unique_lock lock(mutex);
-        const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count();
-
-        if (serverHeadersFound) {
-            // Server-side logic
-            if (remaining <= 2) {
-                if (resetTime > now) {
-                    const auto waitTime = resetTime - now + 50; // +50ms buffer
-#ifdef VERBOSE_LOG
-                    spdlog::info(fmt::format("Rate limit reached (Server). Waiting for {} ms", waitTime));
-#endif
-                    std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
-                }
-            }
-        } else {
-            // Local fallback logic (Sliding Window)
-            // Remove old requests
-            while (!requestTimes.empty() && now - requestTimes.front() > windowSizeMs) {
-                requestTimes.pop_front();
-            }
-
-            if (requestTimes.size() >= localLimit) {
-                // Wait until the oldest request expires
-                const auto oldest = requestTimes.front();
-
-                if (const auto waitTime = (oldest + windowSizeMs) - now + 10; waitTime > 0) {
-#ifdef VERBOSE_LOG
-                    spdlog::info(fmt::format("Rate limit reached (Local). Waiting for {} ms", waitTime));
-#endif
-                    std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
-                    
-                    // After sleeping, we must remove the expired request and add current one
-                    // Update now after sleep
-                     const auto nowAfterWait = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::system_clock::now().time_since_epoch()).count();
-                     while (!requestTimes.empty() && nowAfterWait - requestTimes.front() > windowSizeMs) {
-                        requestTimes.pop_front();
-                    }
-                }
-            }
-            requestTimes.push_back(now);
-        }
+/**
+ * Keeps the recent latencies of an endpoint to derive the hedging threshold
+ */
+class LatencyTracker {
+	static constexpr std::size_t MAX_SAMPLES = 128;
+	static constexpr std::size_t MIN_SAMPLES = 20;
+
+	mutable std::mutex m_locker;
+	std::array<std::chrono::microseconds, MAX_SAMPLES> m_samples{};
+	std::size_t m_numSamples = 0;
+	std::size_t m_nextSample = 0;
+
+public:
+	void add(const std::chrono::microseconds latency) {
+		std::lock_guard lk(m_locker);
+		m_samples[m_nextSample] = latency;
+		m_nextSample = (m_nextSample + 1) % MAX_SAMPLES;
+		m_numSamples = std::min(m_numSamples + 1, MAX_SAMPLES);
+	}
+
+	/**
+	 * @return 95th percentile of the latency, empty until there are enough samples
+	 */
+	[[nodiscard]] std::optional<std::chrono::microseconds> p95() const {
+		std::array<std::chrono::microseconds, MAX_SAMPLES> sorted{};
+		std::size_t numSamples = 0;
+		{
+			std::lock_guard lk(m_locker);
+			numSamples = m_numSamples;
+			std::copy_n(m_samples.begin(), numSamples, sorted.begin());
+		}
+
+		if (numSamples < MIN_SAMPLES) {
+			return std::nullopt;
+		}
+
+		const auto nth = sorted.begin() + static_cast<std::ptrdiff_t>(numSamples * 95 / 100);
+		std::nth_element(sorted.begin(), nth, sorted.begin() + static_cast<std::ptrdiff_t>(numSamples));
+		return *nth;
+	}
+};
+
+/**
+ * Immutable snapshot of the instruments of one category, indexed by symbol. Snapshots are never modified after they are
+ * published, a refresh builds a new one and swaps it in. Only a full download of the category is complete, single
+ * symbols merged into an incomplete snapshot do not make it the whole category.
+ */
+class InstrumentSnapshot {
+	struct SymbolHash {
+		using is_transparent = void;
+
+		std::size_t operator()(const std::string_view symbol) const {
+			return std::hash<std::string_view>{}(symbol);
+		}
+	};
+
+	std::vector<Instrument> m_instruments;
+	std::unordered_map<std::string, std::size_t, SymbolHash, std::equal_to<>> m_index;
+	bool m_complete = false;
+
+public:
+	InstrumentSnapshot() = default;
+
+	/**
+	 * @param instruments
+	 * @param complete true if the instruments are the whole category
+	 */
+	InstrumentSnapshot(std::vector<Instrument> instruments, const bool complete) : m_instruments(std::move(instruments)), m_complete(complete) {
+		m_index.reserve(m_instruments.size());
+
+		for (std::size_t i = 0; i < m_instruments.size(); ++i) {
+			m_index.insert_or_assign(m_instruments[i].symbol, i);
+		}
+	}
+
+	[[nodiscard]] const std::vector<Instrument> &instruments() const {
+		return m_instruments;
+	}
+
+	[[nodiscard]] bool isComplete() const {
+		return m_complete;
+	}
+
+	[[nodiscard]] const Instrument *find(const std::string_view symbol) const {
+		const auto it = m_index.find(symbol);
+		return it == m_index.end() ? nullptr : &m_instruments[it->second];
+	}
+
+	/**
+	 * @return new snapshot with the instruments added or replaced, as complete as this one
+	 */
+	[[nodiscard]] std::shared_ptr<const InstrumentSnapshot> merge(const std::vector<Instrument> &instruments) const {
+		auto merged = m_instruments;
+
+		for (const auto &instrument: instruments) {
+			if (const auto it = m_index.find(instrument.symbol); it != m_index.end()) {
+				merged[it->second] = instrument;
+			} else {
+				merged.push_back(instrument);
+			}
+		}
+
+		return std::make_shared<const InstrumentSnapshot>(std::move(merged), m_complete);
 	}
 };
 
 struct RESTClient::P {
 private:
-	Instruments m_instruments;
-	mutable std::recursive_mutex m_locker;
-    
+	/// Tick and lot sizes rarely change, but an older file is more likely to miss listings and changes
+	static constexpr std::chrono::hours INSTRUMENT_CACHE_MAX_AGE{24};
+
+	/// One snapshot per category, readers on the order path only load the pointer
+	std::array<std::atomic<std::shared_ptr<const InstrumentSnapshot>>, magic_enum::enum_count<Category>()> m_instruments;
+	/// Serializes the read-modify-write of merges and the cache file writes, loads do not take it
+	mutable std::mutex m_instrumentsLocker;
+	std::optional<InstrumentCacheFile> m_instrumentCacheFile;
+	/// Time of the last full download of the category in ms, guarded by the instruments lock
+	std::array<std::int64_t, magic_enum::enum_count<Category>()> m_instrumentTimestamps{};
+
+	/**
+	 * Write the complete categories to the cache file with the times of their downloads, so a category which was not
+	 * refreshed keeps its age. Must be called under the instruments lock.
+	 */
+	void saveInstrumentCache() const {
+		if (!m_instrumentCacheFile) {
+			return;
+		}
+
+		InstrumentCacheContent content;
+
+		for (const auto category: magic_enum::enum_values<Category>()) {
+			if (const auto snapshot = getInstruments(category); snapshot->isComplete()) {
+				content.categories.emplace(category, CachedCategory{m_instrumentTimestamps[static_cast<std::size_t>(category)], snapshot->instruments()});
+			}
+		}
+
+		try {
+			m_instrumentCacheFile->save(content);
+		} catch (...) {
+			/// The file only speeds up the next start, the instruments in memory are valid
+		}
+	}
+
 public:
 	RESTClient *parent = nullptr;
 	std::shared_ptr<HTTPSession> httpSession;
-	mutable RateLimiter rateLimiter; // Add RateLimiter
+	RateLimiter rateLimiter;
+	std::string apiKey;
+	std::optional<int> receiveWindow;
+
+	std::atomic_bool hedging = false;
+	mutable std::atomic<std::uint64_t> hedgesFired = 0;
+	mutable std::atomic<std::uint64_t> hedgesWon = 0;
+	mutable std::mutex latencyLocker;
+	mutable std::map<std::string, std::shared_ptr<LatencyTracker>, std::less<>> latencies;
+
+	mutable std::mutex optionsLocker;
+	CancellationToken cancellationToken;
+	/// Background refreshes of the cached instruments, they use the client and are awaited by its destructor
+	mutable std::vector<std::future<void>> instrumentRefreshes;
+	std::array<RequestDeadlines, 4> deadlines{
+		RequestDeadlines{std::chrono::seconds(2), std::chrono::seconds(2), std::chrono::seconds(1), std::chrono::seconds(2)}, // MarketData
+		RequestDeadlines{std::chrono::seconds(5), std::chrono::seconds(5), std::chrono::seconds(5), std::chrono::seconds(30)}, // History
+		RequestDeadlines{std::chrono::seconds(3), std::chrono::seconds(3), std::chrono::seconds(2), std::chrono::seconds(5)}, // Account
+		RequestDeadlines{std::chrono::seconds(2), std::chrono::seconds(2), std::chrono::seconds(1), std::chrono::seconds(3)} // Trade
+	};
 
 	explicit P(RESTClient *parent) {
 		this->parent = parent;
+
+		for (auto &snapshot: m_instruments) {
+			snapshot.store(std::make_shared<const InstrumentSnapshot>());
+		}
 	}
 
-	[[nodiscard]] Instruments getInstruments() const {
-		std::lock_guard lk(m_locker);
-		return m_instruments;
+	[[nodiscard]] std::shared_ptr<const InstrumentSnapshot> getInstruments(const Category category) const {
+		return m_instruments[static_cast<std::size_t>(category)].load(std::memory_order_acquire);
 	}
 
-	void setInstruments(const Instruments &instruments) {
-		std::lock_guard lk(m_locker);
-		m_instruments = instruments;
+	void setInstruments(const Category category, std::vector<Instrument> instruments) {
+		std::lock_guard lk(m_instrumentsLocker);
+		m_instruments[static_cast<std::size_t>(category)].store(std::make_shared<const InstrumentSnapshot>(std::move(instruments), true), std::memory_order_release);
+		m_instrumentTimestamps[static_cast<std::size_t>(category)] = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		saveInstrumentCache();
 	}
 
-	void setInstruments(const std::vector<Instrument> &instruments) {
-		std::lock_guard lk(m_locker);
-		m_instruments.instruments = instruments;
-	}
-
-	bool findPricePrecisionsForInstrument(const Category category,
-	                                      const std::string &symbol,
-	                                      double &priceStep,
-	                                      double &qtyStep) const {
-		for (const auto symbols = parent->getInstrumentsInfo(category); const auto &symbolEl: symbols) {
-			if (symbolEl.symbol == symbol) {
-				priceStep = symbolEl.priceFilter.tickSize;
-				qtyStep = symbolEl.lotSizeFilter.qtyStep;
-				return true;
+	void mergeInstruments(const Category category, const std::vector<Instrument> &instruments) {
+		std::lock_guard lk(m_instrumentsLocker);
+		auto &snapshot = m_instruments[static_cast<std::size_t>(category)];
+		snapshot.store(snapshot.load(std::memory_order_acquire)->merge(instruments), std::memory_order_release);
+		/// Not persisted, single symbols are merged on the order path and the file is rewritten by the next full refresh
+	}
+
+	/**
+	 * Use the cache file from now on and publish the categories stored in it, except those downloaded more than
+	 * INSTRUMENT_CACHE_MAX_AGE ago
+	 * @return categories loaded from the file
+	 */
+	std::vector<Category> loadInstrumentCache(const std::filesystem::path &path) {
+		std::lock_guard lk(m_instrumentsLocker);
+		m_instrumentCacheFile.emplace(path);
+		std::vector<Category> retVal;
+
+		const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+
+		if (auto content = m_instrumentCacheFile->load()) {
+			for (auto &[category, cached]: content->categories) {
+				if (now - std::chrono::milliseconds(cached.timestamp) > INSTRUMENT_CACHE_MAX_AGE) {
+					continue;
+				}
+
+				m_instruments[static_cast<std::size_t>(category)].store(std::make_shared<const InstrumentSnapshot>(std::move(cached.instruments), true), std::memory_order_release);
+				m_instrumentTimestamps[static_cast<std::size_t>(category)] = cached.timestamp;
+				retVal.push_back(category);
 			}
 		}
-		return false;
+
+		return retVal;
 	}
 
-	http::response<http::string_body> checkResponse(const http::response<http::string_body> &response) const {
+	/**
+	 * Download all pages of the instruments and update the cache with them
+	 * @param endpointClass priority and deadlines of the download, the order path must not wait behind the history
+	 * @return downloaded instruments
+	 */
+	net::awaitable<std::vector<Instrument>>
+	downloadInstruments(const Category category, const std::string &symbol, const EndpointClass endpointClass) const {
+		Instruments instr;
+		std::vector<Instrument> retVal;
+
+		do {
+			instr = co_await getInstrumentsInfo(category, symbol, instr.nextPageCursor, endpointClass);
+			retVal.insert(retVal.end(), std::make_move_iterator(instr.instruments.begin()), std::make_move_iterator(instr.instruments.end()));
+		} while (!instr.nextPageCursor.empty());
+
+		/// A single symbol request refreshes just its entry, the rest of the category stays cached
+		if (symbol.empty()) {
+			setInstruments(category, retVal);
+		} else {
+			mergeInstruments(category, retVal);
+		}
+
+		co_return retVal;
+	}
+
+	/**
+	 * Find the instrument in the cache, downloads it if it is not cached
+	 * @param endpointClass of the download, Trade on the order path
+	 * @return snapshot holding the instrument and the instrument, nullptr if it does not exist
+	 */
+	net::awaitable<std::pair<std::shared_ptr<const InstrumentSnapshot>, const Instrument *>>
+	findInstrument(const Category category, const std::string &symbol, const EndpointClass endpointClass) const {
+		auto snapshot = getInstruments(category);
+
+		if (const auto *instrument = snapshot->find(symbol)) {
+			co_return std::pair{snapshot, instrument};
+		}
+
+		co_await downloadInstruments(category, symbol, endpointClass);
+		snapshot = getInstruments(category);
+		const auto *instrument = snapshot->find(symbol);
+		co_return std::pair{snapshot, instrument};
+	}
+
+	/**
+	 * Run the coroutine on the IO thread of the HTTP session and block until it finishes
+	 * @throws std::runtime_error if called on the IO thread, e.g. from a callback, it would wait for itself
+	 */
+	template<typename ValueType>
+	ValueType runSync(net::awaitable<ValueType> awaitable) const {
+		if (httpSession->isIOThread()) {
+			throw std::runtime_error("Blocking RESTClient method called on its IO thread");
+		}
+
+		return net::co_spawn(httpSession->executor(), std::move(awaitable), net::use_future).get();
+	}
+
+	/**
+	 * Run the coroutine on the IO thread of the HTTP session and its callbacks on the calling thread, so a slow
+	 * callback does not hold back the other requests and it may call the blocking methods
+	 * @param coroutine gets the executor of the calling thread and returns the awaitable
+	 * @throws std::runtime_error if called on the IO thread
+	 */
+	template<typename ValueType, typename Coroutine>
+	ValueType runSyncWithCallbacks(const Coroutine &coroutine) const {
+		if (httpSession->isIOThread()) {
+			throw std::runtime_error("Blocking RESTClient method called on its IO thread");
+		}
+
+		net::io_context callbackContext;
+		std::optional<ValueType> retVal;
+		std::exception_ptr error;
+
+		/// The completion handler is bound to the calling thread, run() returns after it
+		net::co_spawn(httpSession->executor(), coroutine(callbackContext.get_executor()),
+		              net::bind_executor(callbackContext, [&retVal, &error](const std::exception_ptr &e, ValueType value) {
+			              error = e;
+
+			              if (!e) {
+				              retVal = std::move(value);
+			              }
+		              }));
+		callbackContext.run();
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+
+		return std::move(*retVal);
+	}
+
+	net::awaitable<bool> findPricePrecisionsForInstrument(const Category category,
+	                                                      const std::string &symbol,
+	                                                      double &priceStep,
+	                                                      double &qtyStep) const {
+		const auto [snapshot, instrument] = co_await findInstrument(category, symbol, EndpointClass::Trade);
+
+		if (!instrument) {
+			co_return false;
+		}
+
+		priceStep = instrument->priceFilter.tickSize;
+		qtyStep = instrument->lotSizeFilter.qtyStep;
+		co_return true;
+	}
+
+	http::response<http::string_body> checkResponse(const std::string_view path, const http::response<http::string_body> &response) const {
         // Update rate limiter with headers from response
-        rateLimiter.update(response);
+        rateLimiter.update(path, response);
 
 		if (response.result() != http::status::ok) {
 			throw std::runtime_error(
@@ -161,264 +397,922 @@ public:
 		return response;
 	}
 
-	[[nodiscard]] std::vector<Candle>
+	[[nodiscard]] RequestOptions requestOptions(const EndpointClass endpointClass) const {
+		std::lock_guard lk(optionsLocker);
+		return {deadlines[static_cast<std::size_t>(endpointClass)], cancellationToken};
+	}
+
+	net::awaitable<http::response<http::string_body>> get(const RequestBuilder &request, const EndpointClass endpointClass) const {
+		/// Keep the session alive even if the credentials are reset meanwhile
+		const auto session = httpSession;
+		const auto options = requestOptions(endpointClass);
+
+        // Wait if rate limited
+		co_await rateLimiter.acquire(request.path(), requestPriority(endpointClass));
+		co_return checkResponse(request.path(), co_await session->getAsync(request, options));
+	}
+
+	net::awaitable<http::response<http::string_body>> post(const std::string &path, const nlohmann::json &json, const EndpointClass endpointClass) const {
+		const auto session = httpSession;
+		const auto options = requestOptions(endpointClass);
+
+		co_await rateLimiter.acquire(path, requestPriority(endpointClass));
+		co_return checkResponse(path, co_await session->postAsync(path, json, options));
+	}
+
+	[[nodiscard]] std::shared_ptr<LatencyTracker> latencyTracker(const std::string_view path) const {
+		std::lock_guard lk(latencyLocker);
+
+		if (const auto it = latencies.find(path); it != latencies.end()) {
+			return it->second;
+		}
+
+		return latencies.emplace(std::string(path), std::make_shared<LatencyTracker>()).first->second;
+	}
+
+	/**
+	 * GET with hedging: a duplicate is sent when the first attempt does not answer within the p95 latency. Every attempt
+	 * has its own cancellation token, the slower one is cancelled once the result is known and awaited before returning,
+	 * so no attempt outlives the caller. The rate limit headers of both responses reach the limiter.
+	 */
+	net::awaitable<http::response<http::string_body>> getHedged(const RequestBuilder &request, const EndpointClass endpointClass) const {
+		const auto tracker = latencyTracker(request.path());
+		const auto threshold = tracker->p95();
+
+		if (!hedging || !threshold) {
+			const auto session = httpSession;
+			const auto options = requestOptions(endpointClass);
+			co_await rateLimiter.acquire(request.path(), requestPriority(endpointClass));
+
+			/// Measured from the token like the hedged attempts, the wait in the limiter is not the endpoint's latency
+			const auto start = std::chrono::steady_clock::now();
+			auto response = co_await session->getAsync(request, options);
+			tracker->add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+			co_return checkResponse(request.path(), response);
+		}
+
+		struct Hedge {
+			std::shared_ptr<HTTPSession> session;
+			RequestBuilder request;
+			std::shared_ptr<LatencyTracker> tracker;
+			net::steady_timer signal;
+			std::array<CancellationToken, 2> tokens{};
+			std::optional<http::response<http::string_body>> response;
+			std::exception_ptr error;
+			std::size_t winner = 0;
+			int pending = 0;
+
+			void cancel() const {
+				for (const auto &token: tokens) {
+					token.cancel();
+				}
+			}
+		};
+
+		const auto executor = co_await net::this_coro::executor;
+		const auto options = requestOptions(endpointClass);
+		const auto hedge = std::make_shared<Hedge>(Hedge{httpSession, request, tracker, net::steady_timer(executor)});
+
+		const auto launch = [this, executor, hedge, &options](const std::size_t attempt) {
+			auto attemptOptions = options;
+			attemptOptions.cancellationToken = hedge->tokens[attempt];
+			++hedge->pending;
+
+			net::co_spawn(executor, [this, hedge, attempt, attemptOptions]() -> net::awaitable<void> {
+				const auto start = std::chrono::steady_clock::now();
+
+				try {
+					auto response = co_await hedge->session->getAsync(hedge->request, attemptOptions);
+					hedge->tracker->add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+
+					if (!hedge->response) {
+						hedge->response = std::move(response);
+						hedge->winner = attempt;
+					} else {
+						/// The winner's headers are applied by checkResponse()
+						rateLimiter.update(hedge->request.path(), response);
+					}
+				} catch (...) {
+					if (hedge->response) {
+						/// The cancelled first attempt took at least this long, dropping the sample would bias p95 down
+						if (attempt == 0) {
+							hedge->tracker->add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+						}
+					} else if (!hedge->error) {
+						hedge->error = std::current_exception();
+					}
+				}
+
+				--hedge->pending;
+				hedge->signal.cancel();
+			}, net::detached);
+		};
+
+		co_await rateLimiter.acquire(request.path(), requestPriority(endpointClass));
+
+		/// Cancelling the client's requests cancels both attempts
+		std::size_t handlerId = 0;
+
+		if (options.cancellationToken) {
+			handlerId = options.cancellationToken->registerHandler([hedge] { hedge->cancel(); });
+		}
+
+		launch(0);
+
+		bool isHedged = false;
+		hedge->signal.expires_after(*threshold);
+
+		while (hedge->pending > 0) {
+			if (hedge->response) {
+				/// The slower attempt is cancelled and awaited, it must not outlive the caller
+				hedge->cancel();
+				hedge->signal.expires_at(net::steady_timer::time_point::max());
+			}
+
+			beast::error_code ec;
+			co_await hedge->signal.async_wait(net::redirect_error(net::use_awaitable, ec));
+
+			if (!ec && !isHedged && !hedge->response) {
+				isHedged = true;
+				hedge->signal.expires_at(net::steady_timer::time_point::max());
+
+				/// Waiting for a token would likely outlast the first attempt and the token could not be returned, so
+				/// no duplicate is sent while other requests wait in the limiter
+				if (rateLimiter.numWaiting() != 0) {
+					continue;
+				}
+
+				/// The duplicate is charged to the rate limit like any other request. With no waiters the token is
+				/// usually free, the first attempt may still answer meanwhile and then the token is spent for nothing
+				co_await rateLimiter.acquire(request.path(), requestPriority(endpointClass));
+
+				if (!hedge->response && hedge->pending > 0) {
+					++hedgesFired;
+					launch(1);
+				}
+			}
+		}
+
+		if (handlerId != 0) {
+			options.cancellationToken->unregisterHandler(handlerId);
+		}
+
+		if (!hedge->response) {
+			std::rethrow_exception(hedge->error);
+		}
+
+		if (hedge->winner == 1) {
+			++hedgesWon;
+		}
+
+		co_return checkResponse(request.path(), *hedge->response);
+	}
+
+	[[nodiscard]] net::awaitable<std::vector<Candle>>
 	getHistoricalPrices(const Category category,
 	                    const std::string &symbol,
 	                    const CandleInterval interval,
 	                    const std::int64_t startTime,
 	                    const std::int32_t limit) const {
-		const std::string path = "/v5/market/kline";
-		std::map<std::string, std::string> parameters;
-		parameters.insert_or_assign("category", magic_enum::enum_name(category));
-		parameters.insert_or_assign("symbol", symbol);
-		parameters.insert_or_assign("interval", magic_enum::enum_name(interval));
-		parameters.insert_or_assign("start", std::to_string(startTime));
+		RequestBuilder request("/v5/market/kline");
+		request.add("category", category).add("symbol", symbol).add("interval", interval).add("start", startTime);
 
 		if (limit != 200) {
-			parameters.insert_or_assign("limit", std::to_string(limit));
+			request.add("limit", limit);
 		}
-        
-        // Wait if rate limited
-        rateLimiter.wait();
 
-		const auto response = checkResponse(httpSession->get(path, parameters));
-		return handleBybitResponse<Candles>(response).candles;
+		const auto response = co_await get(request, EndpointClass::History);
+		co_return handleBybitResponse<Candles>(response).candles;
 	}
 
-	[[nodiscard]] std::vector<FundingRate> getFundingRates(const Category category,
-	                                                       const std::string &symbol,
-	                                                       const std::int64_t startTime,
-	                                                       const int64_t endTime,
-	                                                       const std::int32_t limit) const {
-		const std::string path = "/v5/market/funding/history";
-		std::map<std::string, std::string> parameters;
-		parameters.insert_or_assign("category", magic_enum::enum_name(category));
-		parameters.insert_or_assign("symbol", symbol);
-		parameters.insert_or_assign("startTime", std::to_string(startTime));
-		parameters.insert_or_assign("endTime", std::to_string(endTime));
+	/**
+	 * Download the candles of the closed time window
+	 * @return candles in the chronological order
+	 */
+	[[nodiscard]] net::awaitable<std::vector<Candle>>
+	getCandleWindow(const Category category,
+	                const std::string &symbol,
+	                const CandleInterval interval,
+	                const std::int64_t startTime,
+	                const std::int64_t endTime) const {
+		RequestBuilder request("/v5/market/kline");
+		request.add("category", category).add("symbol", symbol).add("interval", interval).add("start", startTime)
+		       .add("end", endTime).add("limit", MAX_CANDLES_PER_PAGE);
+
+		const auto response = co_await get(request, EndpointClass::History);
+		auto candles = handleBybitResponse<Candles>(response).candles;
+
+		std::erase_if(candles, [startTime, endTime](const Candle &candle) {
+			return candle.startTime < startTime || candle.startTime > endTime;
+		});
+
+		std::ranges::reverse(candles);
+		co_return candles;
+	}
+
+	[[nodiscard]] net::awaitable<std::vector<FundingRate>> getFundingRates(const Category category,
+	                                                                      const std::string &symbol,
+	                                                                      const std::int64_t startTime,
+	                                                                      const int64_t endTime,
+	                                                                      const std::int32_t limit) const {
+		RequestBuilder request("/v5/market/funding/history");
+		request.add("category", category).add("symbol", symbol).add("startTime", startTime).add("endTime", endTime);
 
 		if (limit != 200) {
-			parameters.insert_or_assign("limit", std::to_string(limit));
+			request.add("limit", limit);
 		}
 
-        // Wait if rate limited
-        rateLimiter.wait();
+		const auto response = co_await get(request, EndpointClass::History);
+		co_return handleBybitResponse<FundingRates>(response).fundingRates;
+	}
+
+	/**
+	 * Download the funding rates of the closed time range, pages are requested backwards from the end
+	 * @return funding rates, newest first
+	 */
+	[[nodiscard]] net::awaitable<std::vector<FundingRate>> getFundingRatePartition(const Category category,
+	                                                                              const std::string &symbol,
+	                                                                              const std::int64_t startTime,
+	                                                                              std::int64_t endTime,
+	                                                                              const std::int32_t limit) const {
+		std::vector<FundingRate> retVal;
+
+		while (startTime <= endTime) {
+			const auto fr = co_await getFundingRates(category, symbol, startTime, endTime, limit);
+
+			if (fr.empty()) {
+				break;
+			}
+
+			retVal.insert(retVal.end(), fr.begin(), fr.end());
+			endTime = fr.back().fundingRateTimestamp - 1;
+		}
+
+		co_return retVal;
+	}
+
+	/**
+	 * Get funding interval of the instrument from the cache, asks the server if the instrument is not cached
+	 * @return funding interval in minutes, 0 if the instrument has no funding
+	 */
+	[[nodiscard]] net::awaitable<int> findFundingInterval(const Category category, const std::string &symbol) const {
+		const auto [snapshot, instrument] = co_await findInstrument(category, symbol, EndpointClass::History);
+		co_return instrument ? instrument->fundingInterval : 0;
+	}
+
+	/**
+	 * Run the tasks on the executor of the caller with at most maxConcurrent of them at the same time
+	 * @param numTasks
+	 * @param maxConcurrent
+	 * @param task returns the awaitable of the task with the given index
+	 * @return results in the order of the tasks
+	 */
+	template<typename ValueType, typename Task>
+	net::awaitable<std::vector<ValueType>> runConcurrently(const std::size_t numTasks, const std::size_t maxConcurrent, const Task &task) const {
+		struct State {
+			std::vector<ValueType> results;
+			std::size_t nextTask = 0;
+			std::size_t activeWorkers = 0;
+			std::exception_ptr error;
+			net::steady_timer done;
+		};
+
+		const auto executor = co_await net::this_coro::executor;
+		const auto state = std::make_shared<State>(State{std::vector<ValueType>(numTasks), 0, 0, nullptr, net::steady_timer(executor, net::steady_timer::time_point::max())});
+		const auto numWorkers = std::clamp<std::size_t>(maxConcurrent, 1, std::max<std::size_t>(numTasks, 1));
+
+		/// Workers only touch the shared state and the task, the caller waits for all of them before returning
+		for (std::size_t i = 0; i < numWorkers; ++i) {
+			++state->activeWorkers;
+			net::co_spawn(executor, [state, &task]() -> net::awaitable<void> {
+				while (!state->error && state->nextTask < state->results.size()) {
+					const auto index = state->nextTask++;
+
+					try {
+						state->results[index] = co_await task(index);
+					} catch (...) {
+						if (!state->error) {
+							state->error = std::current_exception();
+						}
+					}
+				}
+
+				--state->activeWorkers;
+				state->done.cancel();
+			}, net::detached);
+		}
+
+		while (state->activeWorkers > 0) {
+			beast::error_code ec;
+			co_await state->done.async_wait(net::redirect_error(net::use_awaitable, ec));
+		}
 
-		const auto response = checkResponse(httpSession->get(path, parameters));
-		return handleBybitResponse<FundingRates>(response).fundingRates;
+		if (state->error) {
+			std::rethrow_exception(state->error);
+		}
+
+		co_return std::move(state->results);
 	}
 
-	Instruments getInstrumentsInfo(const Category category, const std::string &symbol,
-	                               const std::string &cursor) const {
-		const std::string path = "/v5/market/instruments-info";
-		std::map<std::string, std::string> parameters;
-		parameters.insert_or_assign("category", magic_enum::enum_name(category));
+	/**
+	 * Call the writer of downloaded candles on the executor, or directly if there is none. The calling coroutine
+	 * waits asynchronously, its thread keeps running other requests meanwhile.
+	 */
+	static net::awaitable<void> invokeCallback(const onCandlesDownloaded &callback, const std::vector<Candle> &candles,
+	                                           const net::any_io_executor &executor) {
+		if (!executor) {
+			callback(candles);
+			co_return;
+		}
+
+		co_await net::co_spawn(executor, [&callback, &candles]() -> net::awaitable<void> {
+			callback(candles);
+			co_return;
+		}, net::use_awaitable);
+	}
+
+	/**
+	 * Download the candles page by page, the writer runs on the callback executor if there is one
+	 */
+	net::awaitable<std::vector<Candle>>
+	getHistoricalPriceRange(const Category category,
+	                        const std::string &symbol,
+	                        const CandleInterval interval,
+	                        std::int64_t from,
+	                        const std::int64_t to,
+	                        const std::int32_t limit,
+	                        const onCandlesDownloaded &writer,
+	                        const net::any_io_executor &callbackExecutor) const {
+		std::vector<Candle> retVal;
+		std::vector<Candle> candles = co_await getHistoricalPrices(category, symbol, interval, from, limit);
+
+		while (!candles.empty()) {
+
+			std::ranges::reverse(candles);
+
+			if ((candles.back().startTime - to) < Bybit::numberOfMsForCandleInterval(interval)) {
+				candles.pop_back();
+			}
+
+			if (candles.empty()) {
+				break;
+			}
+
+			const auto first = candles.front();
+			const auto last = candles.back();
+
+
+			if (to < last.startTime) {
+				std::erase_if(candles, [to](const Candle &candle) {
+					return candle.startTime > to;
+				});
+
+				retVal.insert(retVal.end(), candles.begin(), candles.end());
+
+				if (writer && !candles.empty()) {
+					co_await invokeCallback(writer, candles, callbackExecutor);
+				}
+				break;
+			}
+
+			retVal.insert(retVal.end(), candles.begin(), candles.end());
+			from = last.startTime + Bybit::numberOfMsForCandleInterval(interval);
+
+			if (writer) {
+				co_await invokeCallback(writer, candles, callbackExecutor);
+			}
+			candles.clear();
+			candles = co_await getHistoricalPrices(category, symbol, interval, from, limit);
+		}
+
+		co_return retVal;
+	}
+
+	/**
+	 * Download the candles with one page prefetched, the sink runs on the callback executor if there is one
+	 */
+	net::awaitable<std::size_t>
+	streamHistoricalPrices(const Category category,
+	                       const std::string &symbol,
+	                       const CandleInterval interval,
+	                       const std::int64_t from,
+	                       const std::int64_t to,
+	                       const onCandlesDownloaded &sink,
+	                       const net::any_io_executor &callbackExecutor) const {
+		const auto intervalMs = Bybit::numberOfMsForCandleInterval(interval);
+
+		if (intervalMs <= 0 || from > to) {
+			co_return 0;
+		}
+
+		struct Page {
+			std::vector<Candle> candles;
+			std::exception_ptr error;
+			bool isDone = false;
+			net::steady_timer ready;
+		};
+
+		const auto executor = co_await net::this_coro::executor;
+		const auto windowMs = intervalMs * MAX_CANDLES_PER_PAGE;
+
+		const auto fetch = [this, executor, category, symbol, interval, to, windowMs](const std::int64_t startTime) {
+			auto page = std::make_shared<Page>(Page{{}, nullptr, false, net::steady_timer(executor, net::steady_timer::time_point::max())});
+
+			net::co_spawn(executor, [this, page, category, symbol, interval, startTime, endTime = std::min(startTime + windowMs - 1, to)]() -> net::awaitable<void> {
+				try {
+					page->candles = co_await getCandleWindow(category, symbol, interval, startTime, endTime);
+				} catch (...) {
+					page->error = std::current_exception();
+				}
+
+				page->isDone = true;
+				page->ready.cancel();
+			}, net::detached);
+
+			return page;
+		};
+
+		const auto wait = [](const std::shared_ptr<Page> &page) -> net::awaitable<void> {
+			while (!page->isDone) {
+				beast::error_code ec;
+				co_await page->ready.async_wait(net::redirect_error(net::use_awaitable, ec));
+			}
+		};
+
+		std::size_t retVal = 0;
+		std::exception_ptr error;
+		auto next = fetch(from);
+
+		/// The next page is requested before the sink gets the current one, so at most two pages are held. A slow sink
+		/// holds the download back.
+		for (auto startTime = from; startTime <= to; startTime += windowMs) {
+			const auto current = next;
+			co_await wait(current);
+			next = startTime + windowMs <= to ? fetch(startTime + windowMs) : nullptr;
+
+			if (current->error) {
+				error = current->error;
+				break;
+			}
+
+			try {
+				if (!current->candles.empty()) {
+					co_await invokeCallback(sink, current->candles, callbackExecutor);
+					retVal += current->candles.size();
+				}
+			} catch (...) {
+				error = std::current_exception();
+				break;
+			}
+		}
+
+		/// The prefetch must not outlive the call, it refers to the arguments
+		if (next) {
+			co_await wait(next);
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+
+		co_return retVal;
+	}
+
+	/**
+	 * Download the candle windows concurrently, the writer runs on the callback executor if there is one
+	 */
+	net::awaitable<std::vector<Candle>>
+	downloadHistoricalPrices(const Category category,
+	                         const std::string &symbol,
+	                         const CandleInterval interval,
+	                         const std::int64_t from,
+	                         const std::int64_t to,
+	                         const onCandlesDownloaded &writer,
+	                         const std::size_t maxConcurrentRequests,
+	                         const net::any_io_executor &callbackExecutor) const {
+		const auto intervalMs = Bybit::numberOfMsForCandleInterval(interval);
+
+		if (intervalMs <= 0 || from > to) {
+			throw std::invalid_argument("Invalid candle interval or time range");
+		}
+
+		/// Windows are closed ranges, each of them holds at most one page of candles
+		const auto windowMs = intervalMs * MAX_CANDLES_PER_PAGE;
+		const auto numWindows = static_cast<std::size_t>((to - from) / windowMs + 1);
+		const auto numWorkers = std::clamp<std::size_t>(maxConcurrentRequests, 1, numWindows);
+
+		/// Workers run detached on the executor of the caller and share the state with it, all of them on one thread.
+		/// The progress timer never expires, cancelling it wakes up everybody waiting for a change.
+		struct Download {
+			std::vector<std::optional<std::vector<Candle>>> windows;
+			std::size_t nextWindow = 0;
+			std::size_t nextToWrite = 0;
+			std::size_t activeWorkers = 0;
+			std::exception_ptr error;
+			net::steady_timer progress;
+		};
+
+		const auto executor = co_await net::this_coro::executor;
+		const auto download = std::make_shared<Download>(Download{std::vector<std::optional<std::vector<Candle>>>(numWindows), 0, 0, 0, nullptr, net::steady_timer(executor, net::steady_timer::time_point::max())});
+
+		/// Finished windows wait in memory until all the previous ones are written, workers do not run too far ahead
+		const auto maxWindowsAhead = 2 * numWorkers;
+
+		for (std::size_t i = 0; i < numWorkers; ++i) {
+			++download->activeWorkers;
+			net::co_spawn(executor, [this, download, category, symbol, interval, from, to, windowMs, maxWindowsAhead]() -> net::awaitable<void> {
+				while (!download->error && download->nextWindow < download->windows.size()) {
+					if (download->nextWindow >= download->nextToWrite + maxWindowsAhead) {
+						beast::error_code ec;
+						co_await download->progress.async_wait(net::redirect_error(net::use_awaitable, ec));
+						continue;
+					}
+
+					const auto index = download->nextWindow++;
+					const auto startTime = from + static_cast<std::int64_t>(index) * windowMs;
+					const auto endTime = std::min(startTime + windowMs - 1, to);
+
+					try {
+						download->windows[index] = co_await getCandleWindow(category, symbol, interval, startTime, endTime);
+					} catch (...) {
+						if (!download->error) {
+							download->error = std::current_exception();
+						}
+					}
+
+					download->progress.cancel();
+				}
+
+				--download->activeWorkers;
+				download->progress.cancel();
+			}, net::detached);
+		}
+
+		std::vector<Candle> retVal;
+
+		while (download->nextToWrite < numWindows && !download->error) {
+			if (auto &window = download->windows[download->nextToWrite]) {
+				if (writer && !window->empty()) {
+					try {
+						co_await invokeCallback(writer, *window, callbackExecutor);
+					} catch (...) {
+						download->error = std::current_exception();
+						download->progress.cancel();
+						break;
+					}
+				}
+
+				retVal.insert(retVal.end(), window->begin(), window->end());
+				window.reset();
+				++download->nextToWrite;
+				download->progress.cancel();
+				continue;
+			}
+
+			beast::error_code ec;
+			co_await download->progress.async_wait(net::redirect_error(net::use_awaitable, ec));
+		}
+
+		/// The workers use this client, so they must finish before the error is reported
+		while (download->activeWorkers > 0) {
+			beast::error_code ec;
+			co_await download->progress.async_wait(net::redirect_error(net::use_awaitable, ec));
+		}
+
+		if (download->error) {
+			std::rethrow_exception(download->error);
+		}
+
+		co_return retVal;
+	}
+
+	net::awaitable<Instruments> getInstrumentsInfo(const Category category, const std::string &symbol,
+	                                               const std::string &cursor, const EndpointClass endpointClass) const {
+		RequestBuilder request("/v5/market/instruments-info");
+		request.add("category", category);
 
 		if (!symbol.empty()) {
-			parameters.insert_or_assign("symbol", symbol);
+			request.add("symbol", symbol);
 		}
 
 		if (!cursor.empty()) {
-			parameters.insert_or_assign("cursor", cursor);
+			request.add("cursor", cursor);
 		}
-        
-        // Wait if rate limited
-        rateLimiter.wait();
 
-		const auto response = checkResponse(httpSession->get(path, parameters));
-		return handleBybitResponse<Instruments>(response);
+		const auto response = co_await get(request, endpointClass);
+		co_return handleBybitResponse<Instruments>(response);
 	}
 };
 
-RESTClient::RESTClient(const std::string &apiKey, const std::string &apiSecret) : m_p(
+RESTClient::RESTClient(const std::string &apiKey, const std::string &apiSecret, const std::filesystem::path &instrumentCachePath) : m_p(
 	std::make_unique<P>(this)) {
+	m_p->apiKey = apiKey;
 	m_p->httpSession = std::make_shared<HTTPSession>(apiKey, apiSecret);
+
+	if (!instrumentCachePath.empty()) {
+		enableInstrumentCache(instrumentCachePath);
+	}
 }
 
-RESTClient::~RESTClient() = default;
+RESTClient::~RESTClient() {
+	/// The token stays cancelled, the remaining pages of a refresh fail right away
+	CancellationToken token;
+	std::vector<std::future<void>> refreshes;
+	{
+		std::lock_guard lk(m_p->optionsLocker);
+		token = m_p->cancellationToken;
+		refreshes.swap(m_p->instrumentRefreshes);
+	}
+
+	token.cancel();
+
+	for (auto &refresh: refreshes) {
+		refresh.wait();
+	}
+}
 
 void RESTClient::setCredentials(const std::string &apiKey, const std::string &apiSecret) const {
 	m_p->httpSession.reset();
 	m_p->httpSession = std::make_shared<HTTPSession>(apiKey, apiSecret);
+	m_p->apiKey = apiKey;
+
+	if (m_p->receiveWindow) {
+		m_p->httpSession->setReceiveWindow(*m_p->receiveWindow);
+	}
+}
+
+void RESTClient::setReceiveWindow(const int receiveWindow) const {
+	m_p->receiveWindow = receiveWindow;
+	m_p->httpSession->setReceiveWindow(receiveWindow);
+}
+
+void RESTClient::enableInstrumentCache(const std::filesystem::path &path) const {
+	/// Orders use the loaded instruments right away, the refresh replaces them when it is done
+	for (const auto category: m_p->loadInstrumentCache(path)) {
+		auto refresh = net::co_spawn(m_p->httpSession->executor(), [this, category]() -> net::awaitable<void> {
+			try {
+				co_await getInstrumentsInfoAsync(category, "", true);
+			} catch (...) {
+				/// The loaded instruments stay in use, the next request of the category refreshes them
+			}
+		}, net::use_future);
+
+		std::lock_guard lk(m_p->optionsLocker);
+		m_p->instrumentRefreshes.push_back(std::move(refresh));
+	}
+}
+
+void RESTClient::setDeadlines(const EndpointClass endpointClass, const RequestDeadlines &deadlines) const {
+	std::lock_guard lk(m_p->optionsLocker);
+	m_p->deadlines[static_cast<std::size_t>(endpointClass)] = deadlines;
+}
+
+RequestDeadlines RESTClient::getDeadlines(const EndpointClass endpointClass) const {
+	std::lock_guard lk(m_p->optionsLocker);
+	return m_p->deadlines[static_cast<std::size_t>(endpointClass)];
+}
+
+void RESTClient::shareRateLimit() const {
+	m_p->rateLimiter.shareBudget(sharedRateLimitName(m_p->apiKey));
+}
+
+std::string RESTClient::sharedRateLimitName(const std::string &apiKey) {
+	/// FNV-1a, the segment name must not reveal the key and must be the same in all processes
+	std::uint64_t hash = 14695981039346656037ULL;
+
+	for (const auto c: apiKey) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ULL;
+	}
+
+	return fmt::format("vk_bybit_rate_limit_{:016x}", hash);
+}
+
+void RESTClient::setHedging(const bool enabled) const {
+	m_p->hedging = enabled;
+}
+
+HedgingStats RESTClient::getHedgingStats() const {
+	return {m_p->hedgesFired, m_p->hedgesWon};
+}
+
+void RESTClient::cancelPendingRequests() const {
+	CancellationToken token;
+	{
+		std::lock_guard lk(m_p->optionsLocker);
+		std::swap(token, m_p->cancellationToken);
+	}
+
+	token.cancel();
 }
 
 std::vector<Candle>
 RESTClient::getHistoricalPrices(const Category category,
                                 const std::string &symbol,
                                 const CandleInterval interval,
-                                std::int64_t from,
+                                const std::int64_t from,
                                 const std::int64_t to,
                                 const std::int32_t limit,
                                 const onCandlesDownloaded &writer) const {
-	std::vector<Candle> retVal;
-	std::vector<Candle> candles = m_p->getHistoricalPrices(category, symbol, interval, from, limit);
-
-	while (!candles.empty()) {
-
-		std::ranges::reverse(candles);
-
-		if ((candles.back().startTime - to) < Bybit::numberOfMsForCandleInterval(interval)) {
-			candles.pop_back();
-		}
-
-		if (candles.empty()) {
-			break;
-		}
-
-		const auto first = candles.front();
-		const auto last = candles.back();
+	return m_p->runSyncWithCallbacks<std::vector<Candle>>([&](const net::any_io_executor &callbackExecutor) {
+		return m_p->getHistoricalPriceRange(category, symbol, interval, from, to, limit, writer, callbackExecutor);
+	});
+}
 
+net::awaitable<std::vector<Candle>>
+RESTClient::getHistoricalPricesAsync(const Category category,
+                                     const std::string &symbol,
+                                     const CandleInterval interval,
+                                     std::int64_t from,
+                                     const std::int64_t to,
+                                     const std::int32_t limit,
+                                     const onCandlesDownloaded &writer) const {
+	co_return co_await m_p->getHistoricalPriceRange(category, symbol, interval, from, to, limit, writer, {});
+}
 
-		if (to < last.startTime) {
-			for (const auto &candle: candles) {
-				if (candle.startTime <= to) {
-					retVal.push_back(candle);
-				}
-			}
-			if (writer) {
-				writer(candles);
-			}
-			break;
-		}
+std::size_t RESTClient::streamHistoricalPrices(const Category category,
+                                              const std::string &symbol,
+                                              const CandleInterval interval,
+                                              const std::int64_t from,
+                                              const std::int64_t to,
+                                              const onCandlesDownloaded &sink) const {
+	return m_p->runSyncWithCallbacks<std::size_t>([&](const net::any_io_executor &callbackExecutor) {
+		return m_p->streamHistoricalPrices(category, symbol, interval, from, to, sink, callbackExecutor);
+	});
+}
 
-		retVal.insert(retVal.end(), candles.begin(), candles.end());
-		from = last.startTime + Bybit::numberOfMsForCandleInterval(interval);
+net::awaitable<std::size_t>
+RESTClient::streamHistoricalPricesAsync(const Category category,
+                                        const std::string &symbol,
+                                        const CandleInterval interval,
+                                        const std::int64_t from,
+                                        const std::int64_t to,
+                                        const onCandlesDownloaded &sink) const {
+	co_return co_await m_p->streamHistoricalPrices(category, symbol, interval, from, to, sink, {});
+}
 
-		if (writer) {
-			writer(candles);
-		}
-		candles.clear();
-		candles = m_p->getHistoricalPrices(category, symbol, interval, from, limit);
-	}
+std::vector<Candle>
+RESTClient::downloadHistoricalPrices(const Category category,
+                                     const std::string &symbol,
+                                     const CandleInterval interval,
+                                     const std::int64_t from,
+                                     const std::int64_t to,
+                                     const onCandlesDownloaded &writer,
+                                     const std::size_t maxConcurrentRequests) const {
+	return m_p->runSyncWithCallbacks<std::vector<Candle>>([&](const net::any_io_executor &callbackExecutor) {
+		return m_p->downloadHistoricalPrices(category, symbol, interval, from, to, writer, maxConcurrentRequests, callbackExecutor);
+	});
+}
 
-	return retVal;
+net::awaitable<std::vector<Candle>>
+RESTClient::downloadHistoricalPricesAsync(const Category category,
+                                          const std::string &symbol,
+                                          const CandleInterval interval,
+                                          const std::int64_t from,
+                                          const std::int64_t to,
+                                          const onCandlesDownloaded &writer,
+                                          const std::size_t maxConcurrentRequests) const {
+	co_return co_await m_p->downloadHistoricalPrices(category, symbol, interval, from, to, writer, maxConcurrentRequests, {});
 }
 
 WalletBalance RESTClient::getWalletBalance(const AccountType accountType, const std::string &coin) const {
-	const std::string path = "/v5/account/wallet-balance";
-	std::map<std::string, std::string> parameters;
+	return m_p->runSync(getWalletBalanceAsync(accountType, coin));
+}
 
-	parameters.insert_or_assign("accountType", magic_enum::enum_name(accountType));
+net::awaitable<WalletBalance> RESTClient::getWalletBalanceAsync(const AccountType accountType, const std::string &coin) const {
+	RequestBuilder request("/v5/account/wallet-balance");
+	request.add("accountType", accountType);
 
 	if (!coin.empty()) {
-		parameters.insert_or_assign("coin", coin);
+		request.add("coin", coin);
 	}
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->get(path, parameters));
-	return handleBybitResponse<WalletBalance>(response);
+	const auto response = co_await m_p->get(request, EndpointClass::Account);
+	co_return handleBybitResponse<WalletBalance>(response);
 }
 
 std::int64_t RESTClient::getServerTime() const {
-	const std::string path = "/v5/market/time";
-	const std::map<std::string, std::string> parameters;
+	return m_p->runSync(getServerTimeAsync());
+}
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->get(path, parameters));
+net::awaitable<std::int64_t> RESTClient::getServerTimeAsync() const {
+	const RequestBuilder request("/v5/market/time");
+	const auto response = co_await m_p->getHedged(request, EndpointClass::MarketData);
 	const auto timeResponse = handleBybitResponse<ServerTime>(response);
 
-	return timeResponse.timeNano / 1000000;
+	co_return timeResponse.timeNano / 1000000;
 }
 
 std::vector<Position> RESTClient::getPositionInfo(const Category category, const std::string &symbol) const {
-	const std::string path = "/v5/position/list";
-	std::map<std::string, std::string> parameters;
+	return m_p->runSync(getPositionInfoAsync(category, symbol));
+}
 
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
+net::awaitable<std::vector<Position>> RESTClient::getPositionInfoAsync(const Category category, const std::string &symbol) const {
+	RequestBuilder request("/v5/position/list");
+	request.add("category", category);
 
 	if (!symbol.empty()) {
-		parameters.insert_or_assign("symbol", symbol);
+		request.add("symbol", symbol);
 	}
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->get(path, parameters));
-	return handleBybitResponse<Positions>(response).positions;
+	const auto response = co_await m_p->getHedged(request, EndpointClass::Account);
+	co_return handleBybitResponse<Positions>(response).positions;
 }
 
 std::vector<Instrument>
 RESTClient::getInstrumentsInfo(const Category category, const std::string &symbol, const bool force) const {
-	if (m_p->getInstruments().instruments.empty() || force) {
-		Instruments instr;
-		std::vector<Instrument> temp;
-
-		do {
-			instr = m_p->getInstrumentsInfo(category, symbol, instr.nextPageCursor);
+	return m_p->runSync(getInstrumentsInfoAsync(category, symbol, force));
+}
 
-			for (const auto &instrument: instr.instruments) {
-				temp.push_back(instrument);
-			}
-		} while (!instr.nextPageCursor.empty());
+net::awaitable<std::vector<Instrument>>
+RESTClient::getInstrumentsInfoAsync(const Category category, const std::string &symbol, const bool force) const {
+	if (const auto snapshot = m_p->getInstruments(category); !force) {
+		/// Symbols merged on the order path are not the whole category, it is downloaded then
+		if (symbol.empty() && snapshot->isComplete()) {
+			co_return snapshot->instruments();
+		}
 
-		m_p->setInstruments(temp);
+		if (const auto *instrument = snapshot->find(symbol)) {
+			co_return std::vector{*instrument};
+		}
 	}
 
-	return m_p->getInstruments().instruments;
+	co_return co_await m_p->downloadInstruments(category, symbol, EndpointClass::History);
 }
 
-bool RESTClient::setPositionMode(Category category,
+bool RESTClient::setPositionMode(const Category category,
                                  const std::string &symbol,
                                  const std::string &coin,
-                                 PositionMode positionMode) const {
+                                 const PositionMode positionMode) const {
+	return m_p->runSync(setPositionModeAsync(category, symbol, coin, positionMode));
+}
+
+net::awaitable<bool> RESTClient::setPositionModeAsync(Category category,
+                                                      const std::string &symbol,
+                                                      const std::string &coin,
+                                                      PositionMode positionMode) const {
 	if (symbol.empty() && coin.empty()) {
 		throw std::invalid_argument("Invalid parameters symbol/coin");
 	}
 
 	std::string path = "/v5/position/switch-mode";
-	std::map<std::string, std::string> parameters;
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
+	nlohmann::json payload;
+	payload["category"] = magic_enum::enum_name(category);
 
 	if (!symbol.empty()) {
-		parameters.insert_or_assign("symbol", symbol);
+		payload["symbol"] = symbol;
 	}
 	if (!coin.empty()) {
-		parameters.insert_or_assign("coin", coin);
+		payload["coin"] = coin;
 	}
 
-	auto payload = nlohmann::json(parameters);
 	payload["mode"] = positionMode;
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->post(path, payload));
+	const auto response = co_await m_p->post(path, payload, EndpointClass::Account);
 
 	try {
-		return handleBybitResponse<Response>(response).retMsg == "OK";
+		co_return handleBybitResponse<Response>(response).retMsg == "OK";
 	} catch (std::exception &) {
 		Response resp;
 		resp.fromJson(nlohmann::json::parse(response.body()));
 
 		if (resp.retMsg == "Position mode is not modified") {
-			return true;
+			co_return true;
 		}
 	}
 
-	return false;
+	co_return false;
 }
 
 OrderId RESTClient::placeOrder(Order &order) const {
+	return m_p->runSync(placeOrderAsync(order));
+}
+
+net::awaitable<OrderId> RESTClient::placeOrderAsync(Order &order) const {
 	const std::string path = "/v5/order/create";
 
 	double priceStep = 0.01;
 	double qtyStep = 0.01;
 
-	m_p->findPricePrecisionsForInstrument(order.category, order.symbol, priceStep, qtyStep);
+	co_await m_p->findPricePrecisionsForInstrument(order.category, order.symbol, priceStep, qtyStep);
 
 	order.priceStep = priceStep;
 	order.qtyStep = qtyStep;
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->post(path, order.toJson()));
-	return handleBybitResponse<OrderId>(response);
+	const auto response = co_await m_p->post(path, order.toJson(), EndpointClass::Trade);
+	co_return handleBybitResponse<OrderId>(response);
 }
 
 std::vector<OrderResponse> RESTClient::getOpenOrders(const Category category, const std::string &symbol) const {
-	const std::string path = "/v5/order/realtime";
-	std::map<std::string, std::string> parameters;
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
-	parameters.insert_or_assign("symbol", symbol);
+	return m_p->runSync(getOpenOrdersAsync(category, symbol));
+}
+
+net::awaitable<std::vector<OrderResponse>> RESTClient::getOpenOrdersAsync(const Category category, const std::string &symbol) const {
+	RequestBuilder request("/v5/order/realtime");
+	request.add("category", category).add("symbol", symbol);
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->get(path, parameters));
-	return handleBybitResponse<OrdersResponse>(response).orders;
+	const auto response = co_await m_p->get(request, EndpointClass::Account);
+	co_return handleBybitResponse<OrdersResponse>(response).orders;
 }
 
 std::optional<OrderResponse>
@@ -426,35 +1320,40 @@ RESTClient::getOpenOrder(const Category category,
                          const std::string &symbol,
                          const std::string &orderId,
                          const std::string &orderLinkId) const {
-	const std::string path = "/v5/order/realtime";
-	std::map<std::string, std::string> parameters;
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
-	parameters.insert_or_assign("symbol", symbol);
-	parameters.insert_or_assign("orderId", orderId);
-	parameters.insert_or_assign("orderLinkId", orderLinkId);
-
-    m_p->rateLimiter.wait();
-	if (const auto response = m_p->checkResponse(m_p->httpSession->get(path, parameters)); !handleBybitResponse<
+	return m_p->runSync(getOpenOrderAsync(category, symbol, orderId, orderLinkId));
+}
+
+net::awaitable<std::optional<OrderResponse>>
+RESTClient::getOpenOrderAsync(const Category category,
+                              const std::string &symbol,
+                              const std::string &orderId,
+                              const std::string &orderLinkId) const {
+	RequestBuilder request("/v5/order/realtime");
+	request.add("category", category).add("symbol", symbol).add("orderId", orderId).add("orderLinkId", orderLinkId);
+
+	if (const auto response = co_await m_p->get(request, EndpointClass::Account); !handleBybitResponse<
 		OrdersResponse>(response).orders.empty()) {
-		return handleBybitResponse<OrdersResponse>(response).orders.front();
+		co_return handleBybitResponse<OrdersResponse>(response).orders.front();
 	}
 
-	return {};
+	co_return std::nullopt;
 }
 
-std::vector<OrderId> RESTClient::cancelAllOrders(Category category, const std::string &symbol) const {
+std::vector<OrderId> RESTClient::cancelAllOrders(const Category category, const std::string &symbol) const {
+	return m_p->runSync(cancelAllOrdersAsync(category, symbol));
+}
+
+net::awaitable<std::vector<OrderId>> RESTClient::cancelAllOrdersAsync(Category category, const std::string &symbol) const {
 	std::vector<OrderId> retVal;
 	std::string path = "/v5/order/cancel-all";
-	std::map<std::string, std::string> parameters;
-
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
+	nlohmann::json payload;
+	payload["category"] = magic_enum::enum_name(category);
 
 	if (!symbol.empty()) {
-		parameters.insert_or_assign("symbol", symbol);
+		payload["symbol"] = symbol;
 	}
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->post(path, nlohmann::json(parameters)));
+	const auto response = co_await m_p->post(path, payload, EndpointClass::Trade);
 
 	for (const auto res = handleBybitResponse<Response>(response).result; const auto &el: res["list"].
 	     items()) {
@@ -464,37 +1363,47 @@ std::vector<OrderId> RESTClient::cancelAllOrders(Category category, const std::s
 		retVal.push_back(oid);
 	}
 
-	return retVal;
+	co_return retVal;
 }
 
 OrderId RESTClient::cancelOrder(const Category category,
                                 const std::string &symbol,
                                 const std::string &orderId,
                                 const std::string &orderLinkId) const {
+	return m_p->runSync(cancelOrderAsync(category, symbol, orderId, orderLinkId));
+}
+
+net::awaitable<OrderId> RESTClient::cancelOrderAsync(const Category category,
+                                                     const std::string &symbol,
+                                                     const std::string &orderId,
+                                                     const std::string &orderLinkId) const {
 	const std::string path = "/v5/order/cancel";
-	std::map<std::string, std::string> parameters;
-	parameters.insert_or_assign("symbol", symbol);
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
+	nlohmann::json payload;
+	payload["symbol"] = symbol;
+	payload["category"] = magic_enum::enum_name(category);
 
 	if (!orderId.empty()) {
-		parameters.insert_or_assign("orderId", orderId);
+		payload["orderId"] = orderId;
 	}
 
 	if (!orderLinkId.empty()) {
-		parameters.insert_or_assign("orderLinkId", orderId);
+		payload["orderLinkId"] = orderId;
 	}
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->post(path, nlohmann::json(parameters)));
-	return handleBybitResponse<OrderId>(response);
+	const auto response = co_await m_p->post(path, payload, EndpointClass::Trade);
+	co_return handleBybitResponse<OrderId>(response);
 }
 
-void RESTClient::setInstruments(const std::vector<Instrument> &instruments) const {
-	m_p->setInstruments(instruments);
+void RESTClient::setInstruments(const std::vector<Instrument> &instruments, const Category category) const {
+	m_p->setInstruments(category, instruments);
 }
 
 void RESTClient::closeAllPositions(const Category category) const {
-	for (const auto positionList = getPositionInfo(category); const auto &pos: positionList) {
+	m_p->runSync(closeAllPositionsAsync(category));
+}
+
+net::awaitable<void> RESTClient::closeAllPositionsAsync(const Category category) const {
+	for (const auto positionList = co_await getPositionInfoAsync(category); const auto &pos: positionList) {
 		if (!pos.zeroSize) {
 			Order ord;
 			ord.symbol = pos.symbol;
@@ -508,7 +1417,7 @@ void RESTClient::closeAllPositions(const Category category) const {
 			ord.orderType = OrderType::Market;
 			ord.qty = pos.size;
 			ord.timeInForce = TimeInForce::GTC;
-			auto orderResponse = placeOrder(ord);
+			auto orderResponse = co_await placeOrderAsync(ord);
 		}
 	}
 }
@@ -517,38 +1426,71 @@ std::vector<FundingRate>
 RESTClient::getFundingRates(const Category category,
                             const std::string &symbol,
                             const int64_t startTime,
-                            int64_t endTime,
+                            const int64_t endTime,
                             const std::int32_t limit) const {
-	std::vector<FundingRate> retVal;
-	std::vector<FundingRate> fr;
+	return m_p->runSync(getFundingRatesAsync(category, symbol, startTime, endTime, limit));
+}
 
-	if (startTime < endTime) {
-		fr = m_p->getFundingRates(category, symbol, startTime, endTime, limit);
+net::awaitable<std::vector<FundingRate>>
+RESTClient::getFundingRatesAsync(const Category category,
+                                 const std::string &symbol,
+                                 const int64_t startTime,
+                                 const int64_t endTime,
+                                 const std::int32_t limit) const {
+	/// The limit is the partition size, Bybit returns at most 200 records per page
+	if (limit <= 0 || limit > MAX_FUNDING_RATES_PER_PAGE) {
+		throw std::invalid_argument(fmt::format("Invalid funding rate limit: {}", limit));
 	}
 
-	while (!fr.empty()) {
-		retVal.insert(retVal.end(), fr.begin(), fr.end());
-		endTime = fr.back().fundingRateTimestamp - 1;
-		fr.clear();
+	if (startTime >= endTime) {
+		co_return std::vector<FundingRate>{};
+	}
 
-		if (startTime < endTime) {
-			fr = m_p->getFundingRates(category, symbol, startTime, endTime, limit);
-		}
+	/// Funding happens on a fixed schedule, so the range is split up front into partitions of one page of expected
+	/// funding timestamps. A partition still pages if the schedule changed meanwhile and it holds more records.
+	const auto fundingInterval = co_await m_p->findFundingInterval(category, symbol);
+
+	if (fundingInterval <= 0) {
+		co_return co_await m_p->getFundingRatePartition(category, symbol, startTime, endTime, limit);
 	}
 
-	std::ranges::reverse(retVal);
-	return retVal;
+	const auto intervalMs = static_cast<std::int64_t>(fundingInterval) * 60000;
+	const auto partitionMs = intervalMs * limit;
+	const auto firstFunding = (startTime + intervalMs - 1) / intervalMs * intervalMs;
+	const auto numPartitions = firstFunding > endTime ? std::size_t{1} : static_cast<std::size_t>((endTime - firstFunding) / partitionMs + 1);
+
+	const auto partitions = co_await m_p->runConcurrently<std::vector<FundingRate>>(numPartitions, MAX_CONCURRENT_FUNDING_REQUESTS, [&](const std::size_t index) {
+		const auto partitionStart = index == 0 ? startTime : firstFunding + static_cast<std::int64_t>(index) * partitionMs;
+		const auto partitionEnd = std::min(firstFunding + static_cast<std::int64_t>(index + 1) * partitionMs - 1, endTime);
+		return m_p->getFundingRatePartition(category, symbol, partitionStart, partitionEnd, limit);
+	});
+
+	/// Partitions are newest first, they are placed in the chronological order by reverse iterators
+	std::size_t size = 0;
+
+	for (const auto &partition: partitions) {
+		size += partition.size();
+	}
+
+	std::vector<FundingRate> retVal;
+	retVal.reserve(size);
+
+	for (const auto &partition: partitions) {
+		retVal.insert(retVal.end(), partition.rbegin(), partition.rend());
+	}
+
+	co_return retVal;
 }
 
 Tickers RESTClient::getTickers(const Category category, const std::string &symbol) const {
-	const std::string path = "/v5/market/tickers";
+	return m_p->runSync(getTickersAsync(category, symbol));
+}
 
-	std::map<std::string, std::string> parameters;
-	parameters.insert_or_assign("category", magic_enum::enum_name(category));
-	parameters.insert_or_assign("symbol", symbol);
+net::awaitable<Tickers> RESTClient::getTickersAsync(const Category category, const std::string &symbol) const {
+	RequestBuilder request("/v5/market/tickers");
+	request.add("category", category).add("symbol", symbol);
 
-    m_p->rateLimiter.wait();
-	const auto response = m_p->checkResponse(m_p->httpSession->get(path, parameters));
-	return handleBybitResponse<Tickers>(response);
+	const auto response = co_await m_p->getHedged(request, EndpointClass::MarketData);
+	co_return handleBybitResponse<Tickers>(response);
 }
 }
@@ -0,0 +1,203 @@
+/**
+Bybit Server Clock
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_server_clock.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace vk::bybit {
+/// Samples with a longer round trip say almost nothing about the offset
+static constexpr std::int64_t MAX_ROUND_TRIP_IN_US = 5'000'000;
+/// The drift is estimated only when the filtered samples span at least this time
+static constexpr std::int64_t MIN_DRIFT_SPAN_IN_US = 10'000'000;
+/// Plausible crystal drift is tens of ppm, anything bigger is noise
+static constexpr double MAX_DRIFT = 500e-6;
+
+static std::int64_t localTimeInUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct ServerClock::P {
+    struct Sample {
+        std::int64_t localTime = 0;
+        std::int64_t offset = 0;
+        std::int64_t roundTrip = 0;
+    };
+
+    mutable std::mutex locker;
+    std::array<Sample, MAX_SAMPLES> samples{};
+    std::size_t numSamples = 0;
+    std::size_t nextSample = 0;
+
+    bool synchronized = false;
+    std::int64_t lastSampleTime = 0;
+    /// 0 when there is no active sample
+    std::int64_t lastActiveSampleTime = 0;
+    std::int64_t referenceTime = 0;
+    double offset = 0.0;
+    double drift = 0.0;
+    std::int64_t uncertainty = 0;
+
+    [[nodiscard]] double offsetAt(const std::int64_t localTime) const {
+        return offset + drift * static_cast<double>(localTime - referenceTime);
+    }
+
+    void estimate() {
+        std::array<Sample, MAX_SAMPLES> sorted{};
+        std::copy_n(samples.begin(), numSamples, sorted.begin());
+        std::sort(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(numSamples), [](const Sample& lhs, const Sample& rhs) {
+            return lhs.roundTrip < rhs.roundTrip;
+        });
+
+        /// Only the better half of the samples is used, the queueing delay of the other half is too big
+        const auto numFiltered = std::max<std::size_t>(1, numSamples / 2);
+        const auto& best = sorted[0];
+
+        synchronized = true;
+        uncertainty = best.roundTrip / 2;
+        referenceTime = best.localTime;
+        offset = static_cast<double>(best.offset);
+        drift = 0.0;
+
+        if (numFiltered < 3) {
+            return;
+        }
+
+        auto [minTime, maxTime] = std::minmax_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(numFiltered), [](const Sample& lhs, const Sample& rhs) {
+            return lhs.localTime < rhs.localTime;
+        });
+
+        if (maxTime->localTime - minTime->localTime < MIN_DRIFT_SPAN_IN_US) {
+            return;
+        }
+
+        /// Least squares fit of the offset over the local time, centered to keep the precision
+        double meanTime = 0.0;
+        double meanOffset = 0.0;
+
+        for (std::size_t i = 0; i < numFiltered; ++i) {
+            meanTime += static_cast<double>(sorted[i].localTime - best.localTime);
+            meanOffset += static_cast<double>(sorted[i].offset);
+        }
+
+        meanTime /= static_cast<double>(numFiltered);
+        meanOffset /= static_cast<double>(numFiltered);
+
+        double covariance = 0.0;
+        double variance = 0.0;
+
+        for (std::size_t i = 0; i < numFiltered; ++i) {
+            const auto dt = static_cast<double>(sorted[i].localTime - best.localTime) - meanTime;
+            covariance += dt * (static_cast<double>(sorted[i].offset) - meanOffset);
+            variance += dt * dt;
+        }
+
+        if (variance > 0.0) {
+            referenceTime = best.localTime + static_cast<std::int64_t>(std::llround(meanTime));
+            offset = meanOffset;
+            drift = std::clamp(covariance / variance, -MAX_DRIFT, MAX_DRIFT);
+        }
+    }
+};
+
+ServerClock::ServerClock() : m_p(std::make_unique<P>()) {}
+
+ServerClock::~ServerClock() = default;
+
+void ServerClock::addSample(const std::int64_t localSendTime, const std::int64_t serverTime, const std::int64_t localReceiveTime,
+                            const bool isPassive) const {
+    const auto roundTrip = localReceiveTime - localSendTime;
+
+    /// Negative round trip means the local clock was stepped meanwhile
+    if (roundTrip < 0 || roundTrip > MAX_ROUND_TRIP_IN_US) {
+        return;
+    }
+
+    const auto localTime = localSendTime + roundTrip / 2;
+
+    std::lock_guard lk(m_p->locker);
+    m_p->samples[m_p->nextSample] = {localTime, serverTime - localTime, roundTrip};
+    m_p->nextSample = (m_p->nextSample + 1) % MAX_SAMPLES;
+    m_p->numSamples = std::min(m_p->numSamples + 1, MAX_SAMPLES);
+    m_p->lastSampleTime = localReceiveTime;
+
+    if (!isPassive) {
+        m_p->lastActiveSampleTime = localReceiveTime;
+    }
+
+    m_p->estimate();
+}
+
+std::int64_t ServerClock::toServerTime(const std::int64_t localTime) const {
+    std::lock_guard lk(m_p->locker);
+
+    if (!m_p->synchronized) {
+        return localTime;
+    }
+
+    return localTime + static_cast<std::int64_t>(std::llround(m_p->offsetAt(localTime)));
+}
+
+std::int64_t ServerClock::now() const {
+    return toServerTime(localTimeInUs()) / 1000;
+}
+
+bool ServerClock::isSynchronized() const {
+    std::lock_guard lk(m_p->locker);
+    return m_p->synchronized;
+}
+
+std::chrono::microseconds ServerClock::timeSinceLastSample() const {
+    std::lock_guard lk(m_p->locker);
+
+    if (!m_p->synchronized) {
+        return std::chrono::microseconds::max();
+    }
+
+    return std::chrono::microseconds(localTimeInUs() - m_p->lastSampleTime);
+}
+
+std::chrono::microseconds ServerClock::timeSinceLastActiveSample() const {
+    std::lock_guard lk(m_p->locker);
+
+    if (m_p->lastActiveSampleTime == 0) {
+        return std::chrono::microseconds::max();
+    }
+
+    return std::chrono::microseconds(localTimeInUs() - m_p->lastActiveSampleTime);
+}
+
+std::int64_t ServerClock::offset() const {
+    std::lock_guard lk(m_p->locker);
+    return static_cast<std::int64_t>(std::llround(m_p->offsetAt(localTimeInUs())));
+}
+
+double ServerClock::drift() const {
+    std::lock_guard lk(m_p->locker);
+    return m_p->drift * 1e6;
+}
+
+std::int64_t ServerClock::uncertainty() const {
+    std::lock_guard lk(m_p->locker);
+    return m_p->uncertainty;
+}
+
+void ServerClock::reset() const {
+    std::lock_guard lk(m_p->locker);
+    m_p->numSamples = 0;
+    m_p->nextSample = 0;
+    m_p->synchronized = false;
+    m_p->lastActiveSampleTime = 0;
+    m_p->offset = 0.0;
+    m_p->drift = 0.0;
+    m_p->uncertainty = 0;
+}
+} // namespace vk::bybit
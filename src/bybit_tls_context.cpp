@@ -0,0 +1,112 @@
+/**
+Bybit shared TLS Context
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
+*/
+
+#include "vk/bybit/bybit_tls_context.h"
+#include <openssl/ssl.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+namespace vk::bybit {
+namespace ssl = boost::asio::ssl;
+
+struct TLSContext::P {
+    ssl::context ctx{ssl::context::tls_client};
+    std::atomic<bool> sessionResumption = true;
+    std::mutex sessionLocker;
+    std::map<std::string, SSL_SESSION*, std::less<>> sessions;
+
+    P() {
+        ctx.set_default_verify_paths();
+        SSL_CTX_set_min_proto_version(ctx.native_handle(), TLS1_2_VERSION);
+
+        /// Client side cache, sessions are stored by the onNewSession callback only (TLS 1.3 tickets arrive after the
+        /// handshake is finished)
+        SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_set_app_data(ctx.native_handle(), this);
+        SSL_CTX_sess_set_new_cb(ctx.native_handle(), &P::onNewSession);
+    }
+
+    ~P() {
+        clearSessions();
+    }
+
+    static int onNewSession(SSL* ssl, SSL_SESSION* session) {
+        auto* self = static_cast<P*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+
+        if (!self || !host || !self->sessionResumption) {
+            return 0;
+        }
+
+        std::lock_guard lk(self->sessionLocker);
+
+        if (const auto it = self->sessions.find(host); it != self->sessions.end()) {
+            SSL_SESSION_free(it->second);
+            it->second = session;
+        } else {
+            self->sessions.emplace(host, session);
+        }
+
+        /// We took the ownership of the session
+        return 1;
+    }
+
+    void clearSessions() {
+        std::lock_guard lk(sessionLocker);
+
+        for (const auto& [host, session] : sessions) {
+            SSL_SESSION_free(session);
+        }
+
+        sessions.clear();
+    }
+};
+
+TLSContext::TLSContext() : m_p(std::make_unique<P>()) {}
+
+TLSContext::~TLSContext() = default;
+
+TLSContext& TLSContext::instance() {
+    /// Intentionally never destroyed, the SSL context must outlive sessions closed during the static destruction
+    static auto* instance = new TLSContext();
+    return *instance;
+}
+
+ssl::context& TLSContext::context() const { return m_p->ctx; }
+
+bool TLSContext::prepareHandshake(SSL* ssl, const std::string& host) const {
+    if (!SSL_set_tlsext_host_name(ssl, host.c_str())) {
+        return false;
+    }
+
+    if (!m_p->sessionResumption) {
+        return true;
+    }
+
+    std::lock_guard lk(m_p->sessionLocker);
+
+    if (const auto it = m_p->sessions.find(host); it != m_p->sessions.end() && SSL_SESSION_is_resumable(it->second)) {
+        SSL_set_session(ssl, it->second);
+    }
+
+    return true;
+}
+
+void TLSContext::setSessionResumption(const bool enabled) const {
+    m_p->sessionResumption = enabled;
+
+    if (!enabled) {
+        m_p->clearSessions();
+    }
+}
+
+bool TLSContext::isSessionResumptionEnabled() const { return m_p->sessionResumption; }
+
+void TLSContext::clearSessions() const { m_p->clearSessions(); }
+} // namespace vk::bybit
@@ -7,6 +7,7 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 */
 
 #include "vk/bybit/bybit_ws_client.h"
+#include "vk/bybit/bybit_tls_context.h"
 #include <boost/beast/core.hpp>
 #include <thread>
 
@@ -24,7 +25,6 @@ static auto BYBIT_FUTURES_WS_PORT = "443";
 
 struct WebSocketClient::P {
     boost::asio::io_context ioContext;
-    boost::asio::ssl::context ctx;
     std::string host = {BYBIT_FUTURES_WS_HOST};
     std::string port = {BYBIT_FUTURES_WS_PORT};
     std::weak_ptr<WebSocketSession> session;
@@ -32,8 +32,18 @@ struct WebSocketClient::P {
     std::atomic<bool> isRunning = false;
     onLogMessage logMessageCB;
     onDataEvent dataEventCB;
+    onDataEventView dataEventViewCB;
 
-    P() : ctx(boost::asio::ssl::context::sslv23_client) {
+    void dispatchDataEvent(const EventView& eventView) const {
+        if (dataEventViewCB) {
+            dataEventViewCB(eventView);
+        }
+
+        if (dataEventCB) {
+            Event event;
+            event.fromEventView(eventView);
+            dataEventCB(event);
+        }
     }
 };
 
@@ -90,16 +100,28 @@ void WebSocketClient::setDataEventCallback(const onDataEvent& onDataEventCB) con
     m_p->dataEventCB = onDataEventCB;
 }
 
+void WebSocketClient::setDataEventViewCallback(const onDataEventView& onDataEventViewCB) const {
+    m_p->dataEventViewCB = onDataEventViewCB;
+}
+
 void WebSocketClient::subscribe(const std::string& subscriptionFilter) const {
     if (const auto session = m_p->session.lock()) {
         session->subscribe(subscriptionFilter);
         return;
     }
 
-    const auto ws = std::make_shared<WebSocketSession>(m_p->ioContext, m_p->ctx, m_p->logMessageCB);
+    const auto ws = std::make_shared<WebSocketSession>(m_p->ioContext, TLSContext::instance().context(), m_p->logMessageCB);
     std::weak_ptr wp{ws};
     m_p->session = std::move(wp);
-    ws->run(BYBIT_FUTURES_WS_HOST, BYBIT_FUTURES_WS_PORT, subscriptionFilter, m_p->dataEventCB);
+    ws->run(BYBIT_FUTURES_WS_HOST, BYBIT_FUTURES_WS_PORT, subscriptionFilter, [this](const EventView& eventView) {
+        m_p->dispatchDataEvent(eventView);
+    });
+}
+
+void WebSocketClient::resubscribe(const std::string& subscriptionFilter) const {
+    if (const auto session = m_p->session.lock()) {
+        session->resubscribe(subscriptionFilter);
+    }
 }
 
 bool WebSocketClient::isSubscribed(const std::string& subscriptionFilter) const {
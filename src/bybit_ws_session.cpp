@@ -7,10 +7,12 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 */
 
 #include "vk/bybit/bybit_ws_session.h"
+#include "vk/bybit/bybit_tls_context.h"
+#include "vk/bybit/bybit_dns_cache.h"
 #include "vk/utils/log_utils.h"
 #include "vk/utils/json_utils.h"
 #include <nlohmann/json.hpp>
-#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core.hpp>
@@ -22,21 +24,21 @@ namespace vk::bybit {
 static constexpr int PING_INTERVAL_IN_S = 20;
 
 struct WebSocketSession::P {
-    boost::asio::ip::tcp::resolver resolver;
     boost::beast::websocket::stream<boost::beast::ssl_stream<boost::beast::tcp_stream>> ws;
-    boost::beast::multi_buffer buffer;
+    /// Contiguous, the messages are decoded in place
+    boost::beast::flat_buffer buffer;
     std::string host;
     std::vector<std::string> subscriptions;
     std::list<std::string> subscriptionRequests;
     onLogMessage logMessageCB;
-    onDataEvent dataEventCB;
+    onDataEventView dataEventCB;
     boost::asio::steady_timer pingTimer;
     std::chrono::time_point<std::chrono::system_clock> lastPingTime{};
     std::chrono::time_point<std::chrono::system_clock> lastPongTime{};
     mutable std::recursive_mutex subscriptionLocker;
 
     P(boost::asio::io_context &ioc, boost::asio::ssl::context &ctx, const onLogMessage &onLogMessageCB) :
-        resolver(make_strand(ioc)), ws(make_strand(ioc), ctx), logMessageCB(onLogMessageCB), pingTimer(ioc, boost::asio::chrono::seconds(PING_INTERVAL_IN_S)) {}
+        ws(make_strand(ioc), ctx), logMessageCB(onLogMessageCB), pingTimer(ioc, boost::asio::chrono::seconds(PING_INTERVAL_IN_S)) {}
 
     void writeSubscription(const std::string &subscription) {
         std::lock_guard lk(subscriptionLocker);
@@ -58,6 +60,17 @@ struct WebSocketSession::P {
         subscriptionRequests.push_back(subJson.dump());
     }
 
+    void writeResubscription(const std::string &subscription) {
+        std::lock_guard lk(subscriptionLocker);
+
+        for (const auto *operation: {"unsubscribe", "subscribe"}) {
+            nlohmann::json subJson;
+            subJson["op"] = operation;
+            subJson["args"] = std::vector{subscription};
+            subscriptionRequests.push_back(subJson.dump());
+        }
+    }
+
     std::string readSubscription() {
         std::lock_guard lk(subscriptionLocker);
         std::string retVal;
@@ -69,8 +82,13 @@ struct WebSocketSession::P {
         try {
             nlohmann::json subJson = nlohmann::json::parse(subscriptionRequests.front());
 
-            for (const auto &argsJson = subJson["args"]; const auto &arg: argsJson) {
-                subscriptions.push_back(arg);
+            /// A resubscribed stream stays in the subscriptions
+            if (subJson["op"] == "subscribe") {
+                for (const auto &argsJson = subJson["args"]; const std::string arg: argsJson) {
+                    if (std::ranges::find(subscriptions, arg) == subscriptions.end()) {
+                        subscriptions.push_back(arg);
+                    }
+                }
             }
 
             retVal = subscriptionRequests.front();
@@ -82,14 +100,6 @@ struct WebSocketSession::P {
         return retVal;
     }
 
-    static bool isApiControlMsg(const nlohmann::json &json) {
-        if (json.contains("success")) {
-            return true;
-        }
-
-        return false;
-    }
-
     void handleApiControlMsg(const nlohmann::json &json) {
         std::lock_guard lk(subscriptionLocker);
         bool isError = false;
@@ -103,9 +113,11 @@ struct WebSocketSession::P {
             const auto &requestJson = json["request"];
             readValue<std::string>(requestJson, "op", operation);
 
-            for (const auto &argsJson = requestJson["args"]; const std::string arg: argsJson) {
-                if (auto it = std::ranges::find(subscriptions, arg); it != subscriptions.end()) {
-                    subscriptions.erase(it);
+            if (operation == "subscribe") {
+                for (const auto &argsJson = requestJson["args"]; const std::string arg: argsJson) {
+                    if (auto it = std::ranges::find(subscriptions, arg); it != subscriptions.end()) {
+                        subscriptions.erase(it);
+                    }
                 }
             }
 
@@ -128,25 +140,43 @@ struct WebSocketSession::P {
         return false;
     }
 
-    void onResolve(const std::shared_ptr<WebSocketSession> &self, const boost::beast::error_code &ec, const boost::asio::ip::tcp::resolver::results_type &results) {
-        if (ec) {
-            return logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, ec.message()));
-        }
+    void connect(const std::shared_ptr<WebSocketSession> &self, const std::string &port) {
+        /// A host which is not cached yet is resolved on the IO thread without blocking the caller
+        boost::asio::co_spawn(ws.get_executor(), DNSCache::instance().resolveAsync(host, port),
+                              [this, self, port](const std::exception_ptr &e, std::vector<boost::asio::ip::tcp::endpoint> endpoints) {
+                                  if (e) {
+                                      try {
+                                          std::rethrow_exception(e);
+                                      } catch (const std::exception &ex) {
+                                          return logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, ex.what()));
+                                      }
+                                  }
+
+                                  onResolve(self, port, endpoints);
+                              });
+    }
 
+    void onResolve(const std::shared_ptr<WebSocketSession> &self, const std::string &port, const std::vector<boost::asio::ip::tcp::endpoint> &endpoints) {
         get_lowest_layer(ws).expires_after(std::chrono::seconds(30));
 
-        get_lowest_layer(ws).async_connect(
-                results, [this, self](const boost::beast::error_code &e, const boost::asio::ip::tcp::resolver::results_type::endpoint_type &ep) { onConnect(self, e, ep); });
+        /// Endpoints are tried one by one, the host is re-resolved next time only when all of them failed
+        get_lowest_layer(ws).async_connect(endpoints, [this, self, port](const boost::beast::error_code &e, const boost::asio::ip::tcp::endpoint &ep) {
+            if (e) {
+                DNSCache::instance().invalidate(host, port);
+            }
+
+            onConnect(self, e, ep);
+        });
     }
 
-    void onConnect(const std::shared_ptr<WebSocketSession> &self, boost::beast::error_code ec, const boost::asio::ip::tcp::resolver::results_type::endpoint_type &ep) {
+    void onConnect(const std::shared_ptr<WebSocketSession> &self, boost::beast::error_code ec, const boost::asio::ip::tcp::endpoint &ep) {
         if (ec) {
             return logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, ec.message()));
         }
 
         get_lowest_layer(ws).expires_after(std::chrono::seconds(30));
 
-        if (!SSL_set_tlsext_host_name(ws.next_layer().native_handle(), host.c_str())) {
+        if (!TLSContext::instance().prepareHandshake(ws.next_layer().native_handle(), host)) {
             ec = boost::beast::error_code(static_cast<int>(ERR_get_error()), boost::asio::error::get_ssl_category());
             return logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, ec.message()));
         }
@@ -209,33 +239,30 @@ struct WebSocketSession::P {
         }
 
         try {
-            const auto size = buffer.size();
-            std::string strBuffer;
-            strBuffer.reserve(size);
-
-            for (const auto &it: buffer.data()) {
-                strBuffer.append(static_cast<const char *>(it.data()), it.size());
-            }
+            const std::string_view message(static_cast<const char *>(buffer.data().data()), buffer.size());
 
-            buffer.consume(buffer.size());
+            if (const JsonView json(message); json.isObject()) {
+                bool isControl = false;
 
-            if (const nlohmann::json json = nlohmann::json::parse(strBuffer); json.is_object()) {
-                if (isApiControlMsg(json)) {
-                    handleApiControlMsg(json);
-                } else {
-                    try {
-                        Event dataEvent;
-                        dataEvent.fromJson(json);
-
-                        if (dataEventCB) {
-                            dataEventCB(dataEvent);
-                        }
-                    } catch (std::exception &e) {
-                        logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, e.what()));
+                try {
+                    /// One pass over the message both decodes the data event and tells the control messages apart
+                    if (const EventView dataEvent(json); dataEvent.isControl) {
+                        isControl = true;
+                    } else if (dataEventCB) {
+                        dataEventCB(dataEvent);
                     }
+                } catch (std::exception &e) {
+                    logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, e.what()));
+                }
+
+                /// Control messages are rare, only the data messages skip the DOM
+                if (isControl) {
+                    handleApiControlMsg(nlohmann::json::parse(message));
                 }
             }
 
+            buffer.consume(buffer.size());
+
             if (const auto subscription = readSubscription(); !subscription.empty()) {
                 ws.async_write(boost::asio::buffer(subscription),
                                [this, self](const boost::beast::error_code &e, const std::size_t transferred) { onWrite(self, e, transferred); });
@@ -247,7 +274,8 @@ struct WebSocketSession::P {
                 }
                 ws.async_read(buffer, [this, self](const boost::beast::error_code &e, const std::size_t transferred) { onRead(self, e, transferred); });
             }
-        } catch (nlohmann::json::exception &exc) {
+        } catch (std::exception &exc) {
+            buffer.consume(buffer.size());
             logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, exc.what()));
             ws.async_close(boost::beast::websocket::close_code::normal, [this](const boost::beast::error_code &e) { onClose(e); });
         }
@@ -306,9 +334,11 @@ WebSocketSession::~WebSocketSession() {
 
 void WebSocketSession::subscribe(const std::string &subscriptionFilter) const { m_p->writeSubscription(subscriptionFilter); }
 
+void WebSocketSession::resubscribe(const std::string &subscriptionFilter) const { m_p->writeResubscription(subscriptionFilter); }
+
 bool WebSocketSession::isSubscribed(const std::string &subscriptionFilter) const { return m_p->isSubscribed(subscriptionFilter); }
 
-void WebSocketSession::run(const std::string &host, const std::string &port, const std::string &subscriptionFilter, const onDataEvent &dataEventCB) {
+void WebSocketSession::run(const std::string &host, const std::string &port, const std::string &subscriptionFilter, const onDataEventView &dataEventCB) {
     if (subscriptionFilter.empty()) {
         throw std::runtime_error("SubscriptionFilter cannot be empty");
     }
@@ -317,9 +347,7 @@ void WebSocketSession::run(const std::string &host, const std::string &port, con
     m_p->writeSubscription(subscriptionFilter);
     m_p->dataEventCB = dataEventCB;
 
-    auto self = shared_from_this();
-    m_p->resolver.async_resolve(
-            host, port, [this, self](const boost::beast::error_code &ec, const boost::asio::ip::tcp::resolver::results_type &results) { m_p->onResolve(self, ec, results); });
+    m_p->connect(shared_from_this(), port);
 }
 
 void WebSocketSession::close() const { m_p->closeWs(); }
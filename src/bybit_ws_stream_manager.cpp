@@ -9,87 +9,435 @@ Copyright (c) 2022 Vitezslav Kot <vitezslav.kot@gmail.com>.
 #include "vk/bybit/bybit_rest_client.h"
 #include "vk/bybit/bybit_ws_stream_manager.h"
 #include "vk/bybit/bybit_ws_client.h"
+#include "vk/bybit/bybit_seqlock.h"
 #include "vk/utils/utils.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
-
-using namespace std::chrono_literals;
+#include <unordered_map>
 
 namespace vk::bybit {
 struct WSStreamManager::P {
+    enum class StreamType : std::int32_t {
+        Ticker,
+        Candlestick,
+        OrderBook
+    };
+
+    struct TickerValues {
+        double ask1Price{};
+        double ask1Size{};
+        double bid1Price{};
+        double bid1Size{};
+        double lastPrice{};
+    };
+
+    struct CandlestickValues {
+        std::int64_t start{};
+        std::int64_t end{};
+        double open{};
+        double high{};
+        double low{};
+        double close{};
+        double volume{};
+        double turnover{};
+        std::int64_t timestamp{};
+        std::array<char, 8> interval{};
+        bool confirm{false};
+    };
+
+    /// Latest values of one interned symbol, allocated at subscription and never moved nor freed while P lives
+    struct SymbolSlots {
+        const std::string symbol;
+        /// Written only by the IO thread, it accumulates the ticker deltas
+        EventTicker ticker{};
+        SeqLock<TickerValues> tickerValues{};
+        std::array<SeqLock<CandlestickValues>, magic_enum::enum_count<CandleInterval>()> candlestickValues{};
+        /// Incremented after every published value
+        std::atomic<std::uint64_t> version{0};
+        std::atomic<std::uint32_t> numWaiting{0};
+        std::mutex waitLocker;
+        std::condition_variable updated;
+        /// Guarded by waitLocker, set when the manager is being destroyed
+        bool stopped{false};
+
+        explicit SymbolSlots(std::string symbolName) : symbol(std::move(symbolName)) {}
+
+        /**
+         * Wake the waiting readers, the IO thread does not touch the mutex when nobody waits
+         */
+        void notifyUpdate() {
+            version.fetch_add(1);
+
+            if (numWaiting.load() != 0) {
+                /// The waiter either sees the new version or is already waiting and gets the notification
+                { std::lock_guard lk(waitLocker); }
+                updated.notify_all();
+            }
+        }
+
+        /**
+         * @param lastVersion
+         * @param deadline
+         * @return version newer than lastVersion, lastVersion if the deadline passed
+         */
+        std::uint64_t waitForUpdate(const std::uint64_t lastVersion, const std::chrono::steady_clock::time_point deadline) {
+            if (const auto current = version.load(); current != lastVersion) {
+                return current;
+            }
+
+            numWaiting.fetch_add(1);
+            std::unique_lock lk(waitLocker);
+            updated.wait_until(lk, deadline, [&] { return stopped || version.load() != lastVersion; });
+            numWaiting.fetch_sub(1);
+            return version.load();
+        }
+
+        /**
+         * Wake all waiting readers for good, the later waits return immediately
+         */
+        void stop() {
+            {
+                std::lock_guard lk(waitLocker);
+                stopped = true;
+            }
+
+            updated.notify_all();
+        }
+    };
+
+    /// One per order book stream, allocated at subscription and never moved nor freed while P lives
+    struct OrderBookSlot {
+        /// Levels of the subscribed depth, only these are copied to and from the published top
+        std::size_t numLevels{EventOrderBook::MAX_LEVELS};
+        /// Written only by the IO thread
+        OrderBook book{};
+        EventOrderBook scratch{};
+        SeqLock<EventOrderBook> top{};
+    };
+
+    /// Precomputed at subscription, the message is dispatched without parsing its topic
+    struct StreamRoute {
+        StreamType type{StreamType::Ticker};
+        SymbolSlots* slots{};
+        std::size_t intervalIndex{};
+        OrderBookSlot* orderBook{};
+        onEventTicker tickerCB{};
+        onEventCandlestick candlestickCB{};
+        onOrderBook orderBookCB{};
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+
+        std::size_t operator()(const std::string_view value) const {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    /// Immutable, a subscription publishes a new copy so the IO thread and the readers look up without a lock
+    struct RouteTable {
+        std::unordered_map<std::string, StreamRoute, StringHash, std::equal_to<>> routes;
+        std::unordered_map<std::string, SymbolSlots*, StringHash, std::equal_to<>> symbols;
+    };
+
     std::unique_ptr<WebSocketClient> wsClient;
-    int timeout{5};
-    mutable std::recursive_mutex instrumentInfoLocker;
-    mutable std::recursive_mutex candlestickLocker;
-    std::map<std::string, EventTicker> tickers;
-    std::map<std::string, std::map<CandleInterval, EventCandlestick>> candlesticks;
+    std::atomic<int> timeout{5};
+    std::atomic<bool> stopping{false};
+    /// Readers inside waitForValue or waitForUpdate, the destructor waits for them before freeing the slots
+    std::atomic<std::uint32_t> numReaders{0};
+    std::mutex routesLocker;
+    /// Indexed by the symbol id
+    std::vector<std::unique_ptr<SymbolSlots>> symbolSlots;
+    std::vector<std::unique_ptr<OrderBookSlot>> orderBookSlots;
+    /// Replaced tables are kept, a reader may still use them. Subscriptions are rare, so they stay small
+    std::vector<std::unique_ptr<const RouteTable>> routeTables;
+    std::atomic<const RouteTable*> routeTable{};
     onLogMessage logMessageCB;
 
     explicit P() : wsClient(std::make_unique<WebSocketClient>()) {
-        wsClient->setDataEventCallback([&](const Event& event) {
-            if (event.topic.find("tickers") != std::string::npos) {
-                std::lock_guard lk(instrumentInfoLocker);
+        routeTables.push_back(std::make_unique<const RouteTable>());
+        routeTable = routeTables.back().get();
+
+        /// The events are decoded in place, only the fields of the typed events are copied
+        wsClient->setDataEventViewCallback([this](const EventView& event) {
+            const auto* table = routeTable.load(std::memory_order_acquire);
 
+            if (const auto it = table->routes.find(event.topic); it != table->routes.end()) {
                 try {
-                    if (const auto it = tickers.find(readSymbolFromFilter(event.topic)); it == tickers.end()) {
-                        EventTicker eventTicker;
-                        eventTicker.loadEventData(event);
-                        tickers.insert_or_assign(eventTicker.symbol, eventTicker);
-                    } else {
-                        it->second.loadEventData(event);
-                    }
+                    dispatch(it->second, event);
                 } catch (std::exception& e) {
-                    logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, e.what()));
+                    if (logMessageCB) {
+                        logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, e.what()));
+                    }
                 }
-            } else if (event.topic.find("kline") != std::string::npos) {
-                std::lock_guard lk(candlestickLocker);
+            }
+        });
+    }
 
-                try {
-                    EventCandlestick eventCandlestick;
-                    if (const auto candlesNumber = event.data.size(); candlesNumber != 1) {
-                        logMessageCB(LogSeverity::Error, fmt::format("{}: {}: {}", MAKE_FILELINE, "unexpected candles number", candlesNumber));
-                    }
+    void dispatch(const StreamRoute& route, const EventView& event) const {
+        switch (route.type) {
+        case StreamType::Ticker: {
+            auto& ticker = route.slots->ticker;
+            ticker.loadEventData(event);
+            route.slots->tickerValues.store({ticker.ask1Price, ticker.ask1Size, ticker.bid1Price, ticker.bid1Size, ticker.lastPrice});
+            route.slots->notifyUpdate();
 
-                    eventCandlestick.fromJson(event.data[0]);
+            if (route.tickerCB) {
+                route.tickerCB(ticker);
+            }
+            break;
+        }
+        case StreamType::Candlestick: {
+            /// The data is walked once, every candle is parsed, published and dispatched as it is reached
+            std::size_t candlesNumber = 0;
+
+            for (const auto& element: event.data) {
+                EventCandlestick candlestick;
+                candlestick.fromJson(element);
+                ++candlesNumber;
+
+                CandlestickValues values{candlestick.start, candlestick.end, candlestick.open, candlestick.high, candlestick.low, candlestick.close,
+                                         candlestick.volume, candlestick.turnover, candlestick.timestamp, {}, candlestick.confirm};
+                candlestick.interval.copy(values.interval.data(), values.interval.size() - 1);
+                route.slots->candlestickValues[route.intervalIndex].store(values);
+                route.slots->notifyUpdate();
+
+                if (route.candlestickCB) {
+                    route.candlestickCB(candlestick);
+                }
+            }
 
-                    /// Insert new candle
-                    {
-                        const auto symbol = readSymbolFromFilter(event.topic);
-                        auto it = candlesticks.find(symbol);
+            if (candlesNumber != 1 && logMessageCB) {
+                logMessageCB(LogSeverity::Error, fmt::format("{}: {}: {}", MAKE_FILELINE, "unexpected candles number", candlesNumber));
+            }
+            break;
+        }
+        case StreamType::OrderBook: {
+            auto& book = route.orderBook->book;
+            auto result = OrderBookUpdate::Gap;
 
-                        if (it == candlesticks.end()) {
-                            candlesticks.insert({symbol, {}});
-                        }
+            try {
+                result = book.update(event);
+            } catch (std::exception& e) {
+                /// The message may be applied partially
+                book.reset();
 
-                        it = candlesticks.find(symbol);
-                        it->second.insert_or_assign(*magic_enum::enum_cast<CandleInterval>(eventCandlestick.interval), eventCandlestick);
-                    }
-                } catch (std::exception& e) {
+                if (logMessageCB) {
                     logMessageCB(LogSeverity::Error, fmt::format("{}: {}", MAKE_FILELINE, e.what()));
                 }
             }
-        });
+
+            if (result == OrderBookUpdate::Ignored) {
+                return;
+            }
+
+            auto& slot = *route.orderBook;
+            book.top(slot.scratch, slot.numLevels);
+            slot.top.store(slot.scratch, EventOrderBook::sizeWithLevels(slot.numLevels));
+            route.slots->notifyUpdate();
+
+            if (result == OrderBookUpdate::Gap) {
+                if (logMessageCB) {
+                    logMessageCB(LogSeverity::Warning, fmt::format("order book gap, resubscribing: {}", event.topic));
+                }
+
+                wsClient->resubscribe(std::string(event.topic));
+            } else if (route.orderBookCB) {
+                route.orderBookCB(book);
+            }
+            break;
+        }
+        }
+    }
+
+    /**
+     * Intern the symbol and add the route of the subscription, done before subscribing so no message is missed
+     * @param subscriptionFilter topic of the stream
+     * @param route type, interval index and callback of the stream, the slots are filled in
+     * @param pair
+     * @param depth of an order book stream, the number of its published levels
+     */
+    void addRoute(const std::string& subscriptionFilter, StreamRoute route, const std::string& pair, const int depth = 0) {
+        std::lock_guard lk(routesLocker);
+        const auto* current = routeTable.load(std::memory_order_relaxed);
+
+        const auto existing = current->routes.find(subscriptionFilter);
+
+        if (existing != current->routes.end() && !route.tickerCB && !route.candlestickCB && !route.orderBookCB) {
+            return;
+        }
+
+        auto table = std::make_unique<RouteTable>(*current);
+        auto it = table->symbols.find(pair);
+
+        if (it == table->symbols.end()) {
+            symbolSlots.push_back(std::make_unique<SymbolSlots>(pair));
+            it = table->symbols.emplace(pair, symbolSlots.back().get()).first;
+        }
+
+        route.slots = it->second;
+
+        if (route.type == StreamType::OrderBook) {
+            if (existing != current->routes.end()) {
+                route.orderBook = existing->second.orderBook;
+            } else {
+                orderBookSlots.push_back(std::make_unique<OrderBookSlot>());
+                orderBookSlots.back()->numLevels = std::clamp<std::size_t>(depth, 1, EventOrderBook::MAX_LEVELS);
+                route.orderBook = orderBookSlots.back().get();
+            }
+        }
+
+        table->routes.insert_or_assign(subscriptionFilter, std::move(route));
+        routeTables.push_back(std::move(table));
+        routeTable.store(routeTables.back().get(), std::memory_order_release);
+    }
+
+    [[nodiscard]] const StreamRoute* findRoute(const std::string_view subscriptionFilter) const {
+        const auto* table = routeTable.load(std::memory_order_acquire);
+
+        if (const auto it = table->routes.find(subscriptionFilter); it != table->routes.end()) {
+            return &it->second;
+        }
+
+        return nullptr;
     }
 
-    static std::string readSymbolFromFilter(const std::string& subscriptionFilter) {
-        if (const auto records = splitString(subscriptionFilter, '.'); !records.empty()) {
-            return records.back();
+    /**
+     * Find the route of the topic formatted on the stack, the lookup does not allocate
+     * @return route, nullptr if the stream is not subscribed
+     */
+    template<typename... Args>
+    [[nodiscard]] const StreamRoute* findRoute(fmt::format_string<Args...> format, Args&&... args) const {
+        std::array<char, 64> subscriptionFilter{};
+        const auto [end, size] = fmt::format_to_n(subscriptionFilter.data(), subscriptionFilter.size(), format, std::forward<Args>(args)...);
+
+        if (static_cast<std::size_t>(size) > subscriptionFilter.size()) {
+            return nullptr;
         }
 
-        return "";
+        return findRoute(std::string_view(subscriptionFilter.data(), static_cast<std::size_t>(size)));
+    }
+
+    [[nodiscard]] SymbolSlots* findSymbol(const std::string_view pair) const {
+        const auto* table = routeTable.load(std::memory_order_acquire);
+
+        if (const auto it = table->symbols.find(pair); it != table->symbols.end()) {
+            return it->second;
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Read the value, if there is none yet wait for the updates of the symbol until it comes or Timeout passes
+     * @param slots
+     * @param read returns the optional value
+     */
+    /// Counts the reader for the destructor, the count is released after the return value is constructed
+    struct ReaderGuard {
+        std::atomic<std::uint32_t>& numReaders;
+
+        explicit ReaderGuard(std::atomic<std::uint32_t>& readers) : numReaders(readers) { numReaders.fetch_add(1); }
+
+        ~ReaderGuard() { numReaders.fetch_sub(1); }
+
+        ReaderGuard(const ReaderGuard&) = delete;
+
+        ReaderGuard& operator=(const ReaderGuard&) = delete;
+    };
+
+    template<typename Read>
+    std::invoke_result_t<Read> waitForValue(SymbolSlots& slots, const Read& read) {
+        ReaderGuard guard(numReaders);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+        auto version = slots.version.load();
+
+        for (;;) {
+            if (auto retVal = read()) {
+                return retVal;
+            }
+
+            /// No need to wait when destroying object
+            if (stopping || timeout == 0) {
+                return {};
+            }
+
+            const auto current = slots.waitForUpdate(version, deadline);
+
+            if (current == version) {
+                return {};
+            }
+
+            version = current;
+        }
+    }
+
+    static std::optional<EventTicker> readTicker(const SymbolSlots& slots) {
+        TickerValues values;
+
+        if (!slots.tickerValues.load(values)) {
+            return {};
+        }
+
+        EventTicker retVal;
+        retVal.symbol = slots.symbol;
+        retVal.ask1Price = values.ask1Price;
+        retVal.ask1Size = values.ask1Size;
+        retVal.bid1Price = values.bid1Price;
+        retVal.bid1Size = values.bid1Size;
+        retVal.lastPrice = values.lastPrice;
+        return retVal;
+    }
+
+    static std::optional<EventCandlestick> readCandlestick(const SymbolSlots& slots, const CandleInterval interval) {
+        CandlestickValues values;
+
+        if (!slots.candlestickValues[*magic_enum::enum_index(interval)].load(values)) {
+            return {};
+        }
+
+        EventCandlestick retVal;
+        retVal.start = values.start;
+        retVal.end = values.end;
+        retVal.interval = values.interval.data();
+        retVal.open = values.open;
+        retVal.high = values.high;
+        retVal.low = values.low;
+        retVal.close = values.close;
+        retVal.volume = values.volume;
+        retVal.turnover = values.turnover;
+        retVal.confirm = values.confirm;
+        retVal.timestamp = values.timestamp;
+        return retVal;
     }
 };
 
 WSStreamManager::WSStreamManager() : m_p(std::make_unique<P>()) {}
 
 WSStreamManager::~WSStreamManager() {
-    m_p->wsClient.reset();
+    m_p->stopping = true;
     m_p->timeout = 0;
+
+    for (const auto& slots : m_p->symbolSlots) {
+        slots->stop();
+    }
+
+    m_p->wsClient.reset();
+
+    /// The woken readers still touch their slots until they return
+    while (m_p->numReaders.load() != 0) {
+        std::this_thread::yield();
+    }
 }
 
-void WSStreamManager::subscribeTickerStream(const std::string& pair) const {
+void WSStreamManager::subscribeTickerStream(const std::string& pair, const onEventTicker& callback) const {
     std::string subscriptionFilter = "tickers.";
     subscriptionFilter.append(pair);
+    m_p->addRoute(subscriptionFilter, {.type = P::StreamType::Ticker, .tickerCB = callback}, pair);
 
     if (!m_p->wsClient->isSubscribed(subscriptionFilter)) {
         if (m_p->logMessageCB) {
@@ -103,11 +451,28 @@ void WSStreamManager::subscribeTickerStream(const std::string& pair) const {
     m_p->wsClient->run();
 }
 
-void WSStreamManager::subscribeCandlestickStream(const std::string& pair, const CandleInterval interval) const {
+void WSStreamManager::subscribeCandlestickStream(const std::string& pair, const CandleInterval interval, const onEventCandlestick& callback) const {
     std::string subscriptionFilter = "kline.";
     subscriptionFilter.append(magic_enum::enum_name(interval));
     subscriptionFilter.append(".");
     subscriptionFilter.append(pair);
+    m_p->addRoute(subscriptionFilter, {.type = P::StreamType::Candlestick, .intervalIndex = *magic_enum::enum_index(interval), .candlestickCB = callback}, pair);
+
+    if (!m_p->wsClient->isSubscribed(subscriptionFilter)) {
+        if (m_p->logMessageCB) {
+            const auto msgString = fmt::format("subscribing: {}", subscriptionFilter);
+            m_p->logMessageCB(LogSeverity::Info, msgString);
+        }
+
+        m_p->wsClient->subscribe(subscriptionFilter);
+    }
+
+    m_p->wsClient->run();
+}
+
+void WSStreamManager::subscribeOrderBookStream(const std::string& pair, const int depth, const onOrderBook& callback) const {
+    const auto subscriptionFilter = fmt::format("orderbook.{}.{}", depth, pair);
+    m_p->addRoute(subscriptionFilter, {.type = P::StreamType::OrderBook, .orderBookCB = callback}, pair, depth);
 
     if (!m_p->wsClient->isSubscribed(subscriptionFilter)) {
         if (m_p->logMessageCB) {
@@ -131,55 +496,59 @@ void WSStreamManager::setLoggerCallback(const onLogMessage& onLogMessageCB) cons
 }
 
 std::optional<EventTicker> WSStreamManager::readEventTicker(const std::string& pair) const {
-    int numTries = 0;
-    const int maxNumTries = static_cast<int>(m_p->timeout / 0.01);
+    /// The route of the stream, other streams of the pair would make the read wait for a value which never comes
+    const auto* route = m_p->findRoute("tickers.{}", pair);
 
-    while (numTries <= maxNumTries) {
-        if (m_p->timeout == 0) {
-            /// No need to wait when destroying object
-            break;
-        }
+    if (!route) {
+        return {};
+    }
 
-        m_p->instrumentInfoLocker.lock();
+    return m_p->waitForValue(*route->slots, [slots = route->slots] { return P::readTicker(*slots); });
+}
 
-        if (const auto it = m_p->tickers.find(pair); it != m_p->tickers.end()) {
-            auto retVal = it->second;
+std::optional<EventCandlestick> WSStreamManager::readEventCandlestick(const std::string& pair, const CandleInterval interval) const {
+    const auto* route = m_p->findRoute("kline.{}.{}", magic_enum::enum_name(interval), pair);
 
-            m_p->instrumentInfoLocker.unlock();
-            return retVal;
-        }
-        m_p->instrumentInfoLocker.unlock();
-        numTries++;
-        std::this_thread::sleep_for(3ms);
+    if (!route) {
+        return {};
     }
 
-    return {};
+    return m_p->waitForValue(*route->slots, [slots = route->slots, interval] { return P::readCandlestick(*slots, interval); });
 }
 
-std::optional<EventCandlestick> WSStreamManager::readEventCandlestick(const std::string& pair, const CandleInterval interval) const {
-    int numTries = 0;
-    const int maxNumTries = static_cast<int>(m_p->timeout / 0.01);
+std::optional<EventOrderBook> WSStreamManager::readOrderBook(const std::string& pair, const int depth, const std::size_t numLevels) const {
+    const auto* route = m_p->findRoute("orderbook.{}.{}", depth, pair);
 
-    while (numTries <= maxNumTries) {
-        if (m_p->timeout == 0) {
-            /// No need to wait when destroying object
-            break;
-        }
+    if (!route) {
+        return {};
+    }
 
-        m_p->candlestickLocker.lock();
+    /// Only the requested levels are copied out of the slot, the rest of the returned structure stays empty
+    const auto levels = std::min(numLevels, route->orderBook->numLevels);
 
-        if (const auto it = m_p->candlesticks.find(pair); it != m_p->candlesticks.end()) {
-            if (const auto itCandle = it->second.find(interval); itCandle != it->second.end()) {
-                auto retVal = itCandle->second;
-                m_p->candlestickLocker.unlock();
-                return retVal;
-            }
+    return m_p->waitForValue(*route->slots, [route, levels]() -> std::optional<EventOrderBook> {
+        if (EventOrderBook retVal; route->orderBook->top.load(retVal, EventOrderBook::sizeWithLevels(levels)) && retVal.synchronized) {
+            retVal.numBids = std::min(retVal.numBids, levels);
+            retVal.numAsks = std::min(retVal.numAsks, levels);
+            return retVal;
         }
-        m_p->candlestickLocker.unlock();
-        numTries++;
-        std::this_thread::sleep_for(3ms);
+
+        return {};
+    });
+}
+
+std::uint64_t WSStreamManager::waitForUpdate(const std::string& pair, const std::uint64_t lastVersion) const {
+    P::ReaderGuard guard(m_p->numReaders);
+    auto* slots = m_p->findSymbol(pair);
+
+    if (!slots) {
+        return lastVersion;
+    }
+
+    if (m_p->stopping || m_p->timeout == 0) {
+        return slots->version.load();
     }
 
-    return {};
+    return slots->waitForUpdate(lastVersion, std::chrono::steady_clock::now() + std::chrono::seconds(m_p->timeout));
 }
 } // namespace vk::bybit
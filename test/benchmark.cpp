@@ -1,10 +1,31 @@
 #include "vk/bybit/bybit_rest_client.h"
+#include "vk/bybit/bybit_tls_context.h"
+#include "vk/bybit/bybit_hmac_signer.h"
+#include "vk/bybit/bybit_candle_codec.h"
+#include "vk/bybit/bybit_event_models.h"
+#include "vk/bybit/bybit_order_book.h"
 #include "vk/bybit/bybit.h"
 #include <iostream>
 #include <spdlog/spdlog.h>
 #include <fstream>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/x509.h>
 #include "vk/utils/json_utils.h"
 #include "vk/utils/log_utils.h"
+#include "vk/utils/utils.h"
 
 using namespace vk::bybit;
 using namespace std::chrono_literals;
@@ -110,6 +131,472 @@ void measureRestResponses(const std::pair<std::string, std::string>& credentials
     }
 }
 
+/**
+ * Generate a throwaway self-signed EC certificate and load it into the server context
+ */
+void useSelfSignedCertificate(boost::asio::ssl::context& serverCtx) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    SSL_CTX_use_certificate(serverCtx.native_handle(), cert);
+    SSL_CTX_use_PrivateKey(serverCtx.native_handle(), key);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+/**
+ * Measure the TLS handshake time against a local TLS server, first with full handshakes and then with the session
+ * resumption of the shared TLSContext
+ */
+void measureTlsHandshakes() {
+    namespace net = boost::asio;
+    namespace ssl = boost::asio::ssl;
+    using tcp = net::ip::tcp;
+
+    constexpr int numHandshakes = 500;
+
+    ssl::context serverCtx{ssl::context::tls_server};
+    useSelfSignedCertificate(serverCtx);
+
+    net::io_context serverIoc;
+    tcp::acceptor acceptor{serverIoc, {net::ip::make_address("127.0.0.1"), 0}};
+    const auto endpoint = acceptor.local_endpoint();
+
+    std::thread serverThread([&] {
+        for (int i = 0; i < 2 * numHandshakes; i++) {
+            try {
+                ssl::stream<tcp::socket> stream{acceptor.accept(), serverCtx};
+                stream.handshake(ssl::stream_base::server);
+
+                /// The client reads this byte, so it also processes the session tickets sent after the handshake
+                net::write(stream, net::buffer("x", 1));
+                boost::system::error_code ec;
+                [[maybe_unused]] const auto rc = stream.shutdown(ec);
+            } catch (const std::exception& e) {
+                spdlog::warn("TLS server: {}", e.what());
+            }
+        }
+    });
+
+    const auto& tlsContext = vk::bybit::TLSContext::instance();
+
+    const auto runHandshakes = [&](const bool resumption) {
+        tlsContext.setSessionResumption(resumption);
+        tlsContext.clearSessions();
+
+        net::io_context ioc;
+        std::vector<double> times;
+        int numResumed = 0;
+
+        for (int i = 0; i < numHandshakes; i++) {
+            ssl::stream<tcp::socket> stream{ioc, tlsContext.context()};
+            stream.next_layer().connect(endpoint);
+
+            if (!tlsContext.prepareHandshake(stream.native_handle(), "localhost")) {
+                throw std::runtime_error("Failed to set SNI hostname");
+            }
+
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            stream.handshake(ssl::stream_base::client);
+            const auto t2 = std::chrono::high_resolution_clock::now();
+            times.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+
+            if (SSL_session_reused(stream.native_handle())) {
+                numResumed++;
+            }
+
+            char byte;
+            net::read(stream, net::buffer(&byte, 1));
+            boost::system::error_code ec;
+            [[maybe_unused]] const auto rc = stream.shutdown(ec);
+        }
+
+        std::ranges::sort(times);
+        const auto mean = std::accumulate(times.begin(), times.end(), 0.0) / static_cast<double>(times.size());
+        logFunction(vk::LogSeverity::Info, fmt::format("TLS handshake, resumption: {}, mean: {:.1f} us, median: {:.1f} us, p99: {:.1f} us, resumed: {}/{}", resumption, mean,
+                                                       times[times.size() / 2], times[times.size() * 99 / 100], numResumed, numHandshakes));
+    };
+
+    runHandshakes(false);
+    runHandshakes(true);
+    serverThread.join();
+    tlsContext.setSessionResumption(true);
+}
+
+/**
+ * Compare signatures per second of the one-shot HMAC() with hex encoding into std::string (the former signing) and of
+ * the pre-keyed HMACSigner
+ */
+void measureSigning() {
+    constexpr int numSignatures = 1000000;
+    const std::string apiSecret = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+    const std::string message = "1700000000000XXXXXXXXXXXXXXXXXX25000category=linear&symbol=BTCUSDT&orderId=1234567890";
+
+    std::size_t checksum = 0;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < numSignatures; i++) {
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        unsigned int digestLength = SHA256_DIGEST_LENGTH;
+
+        HMAC(EVP_sha256(), apiSecret.data(), static_cast<int>(apiSecret.size()), reinterpret_cast<const unsigned char*>(message.data()), message.length(), digest,
+             &digestLength);
+
+        const std::string signature = vk::stringToHex(digest, sizeof(digest));
+        checksum += static_cast<unsigned char>(signature[i % signature.size()]);
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> oneShot = t2 - t1;
+
+    const vk::bybit::HMACSigner signer(apiSecret);
+    vk::bybit::HMACSigner::Signature signature;
+
+    t1 = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < numSignatures; i++) {
+        signer.sign(message, signature);
+        checksum += static_cast<unsigned char>(signature[i % signature.size()]);
+    }
+
+    t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> preKeyed = t2 - t1;
+
+    logFunction(vk::LogSeverity::Info, fmt::format("One-shot HMAC: {:.0f} signatures/s", numSignatures / oneShot.count()));
+    logFunction(vk::LogSeverity::Info, fmt::format("Pre-keyed HMACSigner: {:.0f} signatures/s (checksum {})", numSignatures / preKeyed.count(), checksum));
+}
+
+/**
+ * Synthetic 1 minute candles: a random walk of the price on a 0.1 tick, the open is the previous close
+ */
+std::vector<vk::bybit::Candle> generateCandles(const std::size_t numCandles) {
+    std::mt19937_64 generator(42);
+    std::normal_distribution<double> move(0.0, 8.0);
+    std::exponential_distribution<double> size(0.01);
+    const auto tick = [](const double value) { return std::round(value * 10.0) / 10.0; };
+
+    std::vector<vk::bybit::Candle> retVal(numCandles);
+    double price = 40000.0;
+
+    for (std::size_t i = 0; i < numCandles; i++) {
+        auto& candle = retVal[i];
+        candle.startTime = 1672531200000 + static_cast<std::int64_t>(i) * vk::bybit::Bybit::numberOfMsForCandleInterval(vk::bybit::CandleInterval::_1);
+        candle.open = price;
+        price = tick(price + move(generator));
+        candle.close = price;
+        candle.high = tick(std::max(candle.open, candle.close) + std::abs(move(generator)) / 2.0);
+        candle.low = tick(std::min(candle.open, candle.close) - std::abs(move(generator)) / 2.0);
+        candle.volume = std::round(size(generator) * 1000.0) / 1000.0;
+        candle.turnover = candle.volume * (candle.open + candle.close) / 2.0;
+    }
+
+    return retVal;
+}
+
+static bool isSameCandle(const vk::bybit::Candle& lhs, const vk::bybit::Candle& rhs) {
+    const auto same = [](const double a, const double b) { return std::bit_cast<std::uint64_t>(a) == std::bit_cast<std::uint64_t>(b); };
+    return lhs.startTime == rhs.startTime && same(lhs.open, rhs.open) && same(lhs.high, rhs.high) && same(lhs.low, rhs.low) &&
+           same(lhs.close, rhs.close) && same(lhs.volume, rhs.volume) && same(lhs.turnover, rhs.turnover);
+}
+
+/**
+ * Check that CandleCodec restores every bit of the candles and rejects a block too short for its first values
+ * @return false if a check failed, the failures are logged
+ */
+bool checkCandleCodec() {
+    bool retVal = true;
+
+    const auto roundTrip = [&](const std::string& name, const std::vector<vk::bybit::Candle>& candles) {
+        const auto decoded = vk::bybit::CandleCodec::decode(vk::bybit::CandleCodec::encode(candles));
+
+        if (decoded.size() != candles.size() || !std::equal(candles.begin(), candles.end(), decoded.begin(), isSameCandle)) {
+            logFunction(vk::LogSeverity::Error, fmt::format("CandleCodec round trip failed: {}", name));
+            retVal = false;
+        }
+    };
+
+    roundTrip("single candle", generateCandles(1));
+    roundTrip("partial last block", generateCandles(2 * vk::bybit::CandleCodec::BLOCK_SIZE + 37));
+
+    auto gaps = generateCandles(3000);
+
+    for (std::size_t i = 0; i < gaps.size(); i += 97) {
+        for (std::size_t j = i; j < gaps.size(); ++j) {
+            gaps[j].startTime += static_cast<std::int64_t>(i % 5 == 0 ? std::int64_t{86'400'000} * 365 : 60'000 * i);
+        }
+    }
+
+    roundTrip("gaps", gaps);
+
+    auto special = generateCandles(50);
+    special[3].close = std::numeric_limits<double>::quiet_NaN();
+    special[4].open = -std::numeric_limits<double>::infinity();
+    special[10].low = -123.456;
+    special[11].high = -0.0;
+    special[12].volume = std::numeric_limits<double>::denorm_min();
+    special[13].turnover = -std::numeric_limits<double>::max();
+    special[20].startTime = -1;
+    roundTrip("NaN and negative values", special);
+
+    /// One candle whose payload holds the padding only: magic, version, number of candles, count, payload size
+    auto damaged = vk::bybit::CandleCodec::encode(generateCandles(1));
+    constexpr std::size_t payloadSizeOffset = 2 * sizeof(std::uint32_t) + sizeof(std::uint64_t) + sizeof(std::uint32_t);
+    constexpr std::uint32_t paddingOnly = 16;
+    std::memcpy(damaged.data() + payloadSizeOffset, &paddingOnly, sizeof(paddingOnly));
+    damaged.resize(payloadSizeOffset + sizeof(paddingOnly) + paddingOnly);
+
+    try {
+        [[maybe_unused]] const auto decoded = vk::bybit::CandleCodec::decode(damaged);
+        logFunction(vk::LogSeverity::Error, "CandleCodec decoded a damaged block");
+        retVal = false;
+    } catch (const std::runtime_error&) {
+    }
+
+    return retVal;
+}
+
+/**
+ * Measure the compression ratio of CandleCodec and the decode throughput in GB/s of raw candles
+ */
+void measureCandleCodec() {
+    if (!checkCandleCodec()) {
+        return;
+    }
+
+    constexpr std::size_t numCandles = 4 * 1024 * 1024;
+    constexpr int numPasses = 5;
+    constexpr auto rawSize = static_cast<double>(numCandles * (sizeof(std::int64_t) + 6 * sizeof(double)));
+
+    const auto candles = generateCandles(numCandles);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    const auto encoded = vk::bybit::CandleCodec::encode(candles);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> encodeTime = t2 - t1;
+
+    double checksum = 0.0;
+    t1 = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < numPasses; i++) {
+        const auto decoded = vk::bybit::CandleCodec::decode(encoded);
+        checksum += decoded[static_cast<std::size_t>(i)].close;
+    }
+
+    t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> decodeTime = t2 - t1;
+
+    logFunction(vk::LogSeverity::Info, fmt::format("Candles: {}, raw: {:.1f} MB, compressed: {:.1f} MB, ratio: {:.2f}",
+                                                   numCandles, rawSize / 1e6, static_cast<double>(encoded.size()) / 1e6,
+                                                   rawSize / static_cast<double>(encoded.size())));
+    logFunction(vk::LogSeverity::Info, fmt::format("Encode: {:.2f} GB/s, decode: {:.2f} GB/s (checksum {})",
+                                                   rawSize / encodeTime.count() / 1e9, numPasses * rawSize / decodeTime.count() / 1e9, checksum));
+}
+
+/// Recorded public stream messages, used when no recording file is given
+static const std::vector<std::string> STREAM_MESSAGES = {
+    R"({"topic":"tickers.BTCUSDT","type":"snapshot","data":{"symbol":"BTCUSDT","tickDirection":"PlusTick","price24hPcnt":"0.017103","lastPrice":"17216.00","prevPrice24h":"16926.50","highPrice24h":"17281.50","lowPrice24h":"16915.00","prevPrice1h":"17238.00","markPrice":"17217.33","indexPrice":"17227.36","openInterest":"68744.761","openInterestValue":"1183601235.91","turnover24h":"1570383121.943499","volume24h":"91705.276","nextFundingTime":"1673280000000","fundingRate":"-0.000212","bid1Price":"17215.50","bid1Size":"84.489","ask1Price":"17216.00","ask1Size":"83.020"},"cs":24987956059,"ts":1673272861686})",
+    R"({"topic":"tickers.BTCUSDT","type":"delta","data":{"symbol":"BTCUSDT","markPrice":"17217.95","indexPrice":"17227.62","bid1Price":"17215.50","bid1Size":"84.531","ask1Price":"17216.00","ask1Size":"82.977"},"cs":24987956060,"ts":1673272861786})",
+    R"({"topic":"tickers.BTCUSDT","type":"delta","data":{"symbol":"BTCUSDT","lastPrice":"17216.50","turnover24h":"1570384843.593499","volume24h":"91705.376","bid1Price":"17216.00","bid1Size":"0.100","ask1Price":"17216.50","ask1Size":"79.430"},"cs":24987956083,"ts":1673272861886})",
+    R"({"topic":"kline.1.BTCUSDT","data":[{"start":1672324800000,"end":1672324859999,"interval":"1","open":"16649.5","close":"16677","high":"16677","low":"16608","volume":"2.081","turnover":"34666.4005","confirm":false,"timestamp":1672324988882}],"ts":1672324988882,"type":"snapshot"})"
+};
+
+/**
+ * Compare messages per second of the former stream decoding (copy of the frame, JSON DOM, Event) and of the in-place
+ * decoding into EventView
+ * @param path recording with one message per line, the embedded messages are used if empty
+ */
+void measureStreamDecoding(const std::string& path) {
+    constexpr int numPasses = 200;
+
+    auto messages = STREAM_MESSAGES;
+
+    if (!path.empty()) {
+        messages.clear();
+        std::ifstream file(path);
+
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty()) {
+                messages.push_back(line);
+            }
+        }
+    }
+
+    /// Repeat the messages to get a stream big enough for the measurement
+    std::vector<std::string> stream;
+
+    while (stream.size() < 10000) {
+        stream.insert(stream.end(), messages.begin(), messages.end());
+    }
+
+    double checksum = 0.0;
+    vk::bybit::EventTicker ticker;
+    vk::bybit::EventCandlestick candlestick;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    for (int pass = 0; pass < numPasses; pass++) {
+        for (const auto& message: stream) {
+            const std::string strBuffer(message);
+            vk::bybit::Event event;
+            event.fromJson(nlohmann::json::parse(strBuffer));
+
+            if (event.topic.starts_with("tickers")) {
+                ticker.loadEventData(event);
+                checksum += ticker.bid1Price;
+            } else if (event.topic.starts_with("kline")) {
+                candlestick.fromJson(event.data[0]);
+                checksum += candlestick.close;
+            }
+        }
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> domTime = t2 - t1;
+
+    t1 = std::chrono::high_resolution_clock::now();
+
+    for (int pass = 0; pass < numPasses; pass++) {
+        for (const auto& message: stream) {
+            const vk::bybit::EventView event{vk::bybit::JsonView(message)};
+
+            if (event.topic.starts_with("tickers")) {
+                ticker.loadEventData(event);
+                checksum += ticker.bid1Price;
+            } else if (event.topic.starts_with("kline")) {
+                candlestick.fromJson(*event.data.begin());
+                checksum += candlestick.close;
+            }
+        }
+    }
+
+    t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> viewTime = t2 - t1;
+
+    const auto numMessages = static_cast<double>(stream.size()) * numPasses;
+    logFunction(vk::LogSeverity::Info, fmt::format("JSON DOM: {:.0f} messages/s", numMessages / domTime.count()));
+    logFunction(vk::LogSeverity::Info, fmt::format("In place: {:.0f} messages/s (checksum {})", numMessages / viewTime.count(), checksum));
+}
+
+/**
+ * Synthetic orderbook.200 stream on a 0.1 tick: a snapshot and deltas changing 1-4 levels near the top of the book,
+ * a third of the changes remove the level
+ */
+std::vector<std::string> generateOrderBookMessages(const std::size_t numDeltas) {
+    constexpr std::int64_t midTick = 400000;
+    constexpr int snapshotLevels = 200;
+
+    std::mt19937_64 generator(42);
+    std::geometric_distribution<std::int64_t> distance(0.15);
+    std::uniform_int_distribution<int> numChanges(1, 4);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::exponential_distribution<double> size(0.5);
+
+    const auto appendLevel = [](std::string& out, const std::int64_t tick, const double levelSize) {
+        if (!out.empty()) {
+            out.push_back(',');
+        }
+
+        fmt::format_to(std::back_inserter(out), R"(["{:.1f}","{:.3f}"])", static_cast<double>(tick) / 10.0, levelSize);
+    };
+
+    std::string bids;
+    std::string asks;
+
+    for (int i = 0; i < snapshotLevels; i++) {
+        appendLevel(bids, midTick - 1 - i, size(generator) + 0.001);
+        appendLevel(asks, midTick + 1 + i, size(generator) + 0.001);
+    }
+
+    std::int64_t ts = 1672304484978;
+    std::vector<std::string> retVal;
+    retVal.reserve(numDeltas + 1);
+    retVal.push_back(fmt::format(R"({{"topic":"orderbook.200.BTCUSDT","type":"snapshot","ts":{},"data":{{"s":"BTCUSDT","b":[{}],"a":[{}],"u":1,"seq":1000}},"cts":{}}})",
+                                 ts, bids, asks, ts));
+
+    for (std::size_t i = 1; i <= numDeltas; i++) {
+        bids.clear();
+        asks.clear();
+        ts += 10;
+
+        for (int j = numChanges(generator); j > 0; j--) {
+            const auto levelSize = uniform(generator) < 0.3 ? 0.0 : size(generator) + 0.001;
+
+            if (uniform(generator) < 0.5) {
+                appendLevel(bids, midTick - 1 - distance(generator), levelSize);
+            } else {
+                appendLevel(asks, midTick + 1 + distance(generator), levelSize);
+            }
+        }
+
+        retVal.push_back(fmt::format(R"({{"topic":"orderbook.200.BTCUSDT","type":"delta","ts":{},"data":{{"s":"BTCUSDT","b":[{}],"a":[{}],"u":{},"seq":{}}},"cts":{}}})",
+                                     ts, bids, asks, i + 1, 1000 + i, ts));
+    }
+
+    return retVal;
+}
+
+/**
+ * Measure order book deltas applied per second, including the in-place decoding of the messages
+ * @param path recording of an orderbook stream with one message per line, synthetic messages are used if empty
+ */
+void measureOrderBook(const std::string& path) {
+    constexpr int numPasses = 10;
+
+    std::vector<std::string> messages;
+
+    if (path.empty()) {
+        messages = generateOrderBookMessages(500000);
+    } else {
+        std::ifstream file(path);
+
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty()) {
+                messages.push_back(line);
+            }
+        }
+    }
+
+    vk::bybit::OrderBook book;
+    std::size_t numDeltas = 0;
+    std::size_t numGaps = 0;
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+
+    /// Every pass starts by the snapshot, it resets the update id
+    for (int pass = 0; pass < numPasses; pass++) {
+        for (const auto& message: messages) {
+            const vk::bybit::EventView event{vk::bybit::JsonView(message)};
+            const auto result = book.update(event);
+
+            if (result == vk::bybit::OrderBookUpdate::Applied && event.type == vk::bybit::ResponseType::delta) {
+                numDeltas++;
+            } else if (result == vk::bybit::OrderBookUpdate::Gap) {
+                numGaps++;
+            }
+        }
+    }
+
+    const auto t2 = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> updateTime = t2 - t1;
+
+    logFunction(vk::LogSeverity::Info, fmt::format("Order book: {:.0f} deltas/s, gaps: {}, levels: {}/{}", static_cast<double>(numDeltas) / updateTime.count(),
+                                                   numGaps, book.numBids(), book.numAsks()));
+
+    if (book.numBids() > 0 && book.numAsks() > 0) {
+        logFunction(vk::LogSeverity::Info, fmt::format("Best bid: {}, best ask: {}", book.bid(0).price, book.ask(0).price));
+    }
+}
+
 int main(const int argc, char** argv) {
     if (argc <= 1) {
         spdlog::error("No parameters!");
@@ -117,8 +604,20 @@ int main(const int argc, char** argv) {
     }
 
     try {
-        const auto credentials = readCredentials(argv[1]);
-        measureRestResponses(credentials);
+        if (const std::string_view mode = argv[1]; mode == "--tls") {
+            measureTlsHandshakes();
+        } else if (mode == "--hmac") {
+            measureSigning();
+        } else if (mode == "--candles") {
+            measureCandleCodec();
+        } else if (mode == "--ws") {
+            measureStreamDecoding(argc > 2 ? argv[2] : "");
+        } else if (mode == "--orderbook") {
+            measureOrderBook(argc > 2 ? argv[2] : "");
+        } else {
+            const auto credentials = readCredentials(argv[1]);
+            measureRestResponses(credentials);
+        }
     }
     catch (const std::exception& e) {
         spdlog::error("Exception: {}", e.what());
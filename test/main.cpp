@@ -1,5 +1,9 @@
 #include "vk/bybit/bybit.h"
 #include "vk/bybit/bybit_rest_client.h"
+#include "vk/bybit/bybit_request_builder.h"
+#include "vk/bybit/bybit_backfill_scheduler.h"
+#include "vk/bybit/bybit_candle_store.h"
+#include "vk/bybit/bybit_candle_file.h"
 #include "vk/bybit/bybit_ws_stream_manager.h"
 #include "vk/utils/json_utils.h"
 #include "vk/utils/log_utils.h"
@@ -12,12 +16,34 @@
 #include <spdlog/spdlog.h>
 #include <future>
 #include <boost/multiprecision/cpp_dec_float.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 
 using namespace vk::bybit;
 using namespace std::chrono_literals;
 
 constexpr int HISTORY_LENGTH_IN_S = 86400; // 1 day
 
+static std::atomic_bool g_countAllocations{false};
+static std::atomic_size_t g_numAllocations{0};
+
+void* operator new(const std::size_t size) {
+    if (g_countAllocations) {
+        ++g_numAllocations;
+    }
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
 void logFunction(const vk::LogSeverity severity, const std::string& errmsg) {
     switch (severity) {
     case vk::LogSeverity::Info:
@@ -108,6 +134,116 @@ void testHistory() {
     }
 }
 
+void testDownloadHistory() {
+    try {
+        const auto [fst, snd] = readCredentials();
+        const auto restClient = std::make_unique<RESTClient>(fst, snd);
+
+        const auto from = std::chrono::seconds(std::time(nullptr)).count() - 30 * HISTORY_LENGTH_IN_S;
+        const auto to = std::chrono::seconds(std::time(nullptr)).count();
+        std::int64_t lastTime = 0;
+        bool isOrdered = true;
+
+        const auto candles = restClient->downloadHistoricalPrices(Category::linear, "BTCUSDT", CandleInterval::_1, from * 1000, to * 1000,
+                                                                  [&](const std::vector<Candle>& window) {
+                                                                      isOrdered = isOrdered && window.front().startTime > lastTime;
+                                                                      lastTime = window.back().startTime;
+                                                                  }, 8);
+
+        if (isOrdered && checkCandles(candles, CandleInterval::_1)) {
+            logFunction(vk::LogSeverity::Info, fmt::format("Candles OK, count: {}", candles.size()));
+        }
+        else {
+            logFunction(vk::LogSeverity::Error, "Candles Not OK");
+        }
+    }
+    catch (std::exception& e) {
+        logFunction(vk::LogSeverity::Critical, e.what());
+    }
+}
+
+void testBackfill() {
+    try {
+        const auto [fst, snd] = readCredentials();
+        const auto restClient = std::make_shared<RESTClient>(fst, snd);
+        const BackfillScheduler scheduler(restClient, 8, "backfill.checkpoint");
+
+        const auto to = std::chrono::seconds(std::time(nullptr)).count() * 1000;
+        const auto from = to - 7LL * HISTORY_LENGTH_IN_S * 1000;
+
+        for (const auto& symbol: {"BTCUSDT", "ETHUSDT", "SOLUSDT", "XRPUSDT"}) {
+            scheduler.addJob({BackfillType::Candles, Category::linear, symbol, CandleInterval::_1, from, to});
+            scheduler.addJob({BackfillType::FundingRates, Category::linear, symbol, CandleInterval::_1, from, to});
+        }
+
+        scheduler.run([](const BackfillJob& job, const std::vector<Candle>& candles) {
+            logFunction(vk::LogSeverity::Info, fmt::format("{}: {} candles", job.symbol, candles.size()));
+        }, [](const BackfillJob& job, const std::vector<FundingRate>& fundingRates) {
+            logFunction(vk::LogSeverity::Info, fmt::format("{}: {} funding rates", job.symbol, fundingRates.size()));
+        });
+
+        const auto stats = scheduler.getStats();
+        logFunction(vk::LogSeverity::Info, fmt::format("Backfill: {} jobs, {} failed, {:.1f} pages/s, {:.0f} candles/s",
+                                                       stats.completedJobs, stats.failedJobs, stats.pagesPerSecond, stats.candlesPerSecond));
+    }
+    catch (std::exception& e) {
+        logFunction(vk::LogSeverity::Critical, e.what());
+    }
+}
+
+void testCandleStore() {
+    try {
+        const auto [fst, snd] = readCredentials();
+        const auto restClient = std::make_shared<RESTClient>(fst, snd);
+        const CandleStore store(restClient, "candle_store");
+
+        const auto to = std::chrono::seconds(std::time(nullptr)).count() * 1000;
+        const auto from = to - 30LL * HISTORY_LENGTH_IN_S * 1000;
+
+        for (const auto pass: {"Cold", "Warm"}) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto candles = store.getCandles(Category::linear, "BTCUSDT", CandleInterval::_1, from, to);
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+            logFunction(checkCandles(candles, CandleInterval::_1) ? vk::LogSeverity::Info : vk::LogSeverity::Error,
+                        fmt::format("{} read: {} candles in {} ms", pass, candles.size(), elapsed.count()));
+        }
+
+        logFunction(vk::LogSeverity::Info, fmt::format("Holes: {}", store.verify(Category::linear, "BTCUSDT", CandleInterval::_1)));
+    }
+    catch (std::exception& e) {
+        logFunction(vk::LogSeverity::Critical, e.what());
+    }
+}
+
+void testCandleFile() {
+    try {
+        const auto [fst, snd] = readCredentials();
+        const auto restClient = std::make_shared<RESTClient>(fst, snd);
+        const CandleFile file("candles_BTCUSDT_1", CandleFileMode::ReadWrite);
+
+        const auto to = std::chrono::seconds(std::time(nullptr)).count() * 1000;
+        const auto from = to - 7LL * HISTORY_LENGTH_IN_S * 1000;
+
+        restClient->downloadHistoricalPrices(Category::linear, "BTCUSDT", CandleInterval::_1, from, to,
+                                             [&](const std::vector<Candle>& candles) { file.append(candles); });
+
+        const CandleFile reader("candles_BTCUSDT_1");
+        const auto day = reader.find(to - 24LL * 60 * 60 * 1000, to);
+        std::vector<Candle> candles;
+
+        for (std::size_t i = 0; i < day.size(); ++i) {
+            candles.push_back(day.candle(i));
+        }
+
+        logFunction(checkCandles(candles, CandleInterval::_1) ? vk::LogSeverity::Info : vk::LogSeverity::Error,
+                    fmt::format("Stored: {} candles, last day: {} candles", reader.size(), day.size()));
+    }
+    catch (std::exception& e) {
+        logFunction(vk::LogSeverity::Critical, e.what());
+    }
+}
+
 void measureRestResponses() {
     const auto [fst, snd] = readCredentials();
     const auto restClient = std::make_shared<RESTClient>(fst, snd);
@@ -275,6 +411,50 @@ void testWebsockets() {
     }
 }
 
+void testWebsocketUpdates() {
+    const auto wsManager = std::make_unique<WSStreamManager>();
+    wsManager->setLoggerCallback(&logFunction);
+
+    wsManager->subscribeTickerStream("BTCUSDT");
+    wsManager->subscribeCandlestickStream("BTCUSDT", CandleInterval::_1, [](const EventCandlestick& event) {
+        logFunction(vk::LogSeverity::Info, fmt::format("BTC candle: {}, close: {}", event.start, event.close));
+    });
+
+    std::uint64_t version = 0;
+
+    for (int i = 0; i < 100; i++) {
+        const auto current = wsManager->waitForUpdate("BTCUSDT", version);
+
+        if (current == version) {
+            logFunction(vk::LogSeverity::Warning, "No update");
+            continue;
+        }
+
+        version = current;
+
+        if (const auto ret = wsManager->readEventTicker("BTCUSDT")) {
+            logFunction(vk::LogSeverity::Info, fmt::format("Update: {}, BTC bid: {}, ask: {}", version, ret->bid1Price, ret->ask1Price));
+        }
+    }
+}
+
+void testOrderBook() {
+    const auto wsManager = std::make_unique<WSStreamManager>();
+    wsManager->setLoggerCallback(&logFunction);
+    wsManager->subscribeOrderBookStream("BTCUSDT", 50);
+
+    std::uint64_t version = 0;
+
+    for (int i = 0; i < 100; i++) {
+        version = wsManager->waitForUpdate("BTCUSDT", version);
+
+        if (const auto ret = wsManager->readOrderBook("BTCUSDT", 50, 1); ret && ret->numBids > 0 && ret->numAsks > 0) {
+            logFunction(vk::LogSeverity::Info, fmt::format("Order book: {}, BTC bid: {} ({}), ask: {} ({})", ret->updateId, ret->bid(0).price, ret->bid(0).size,
+                                                           ret->ask(0).price, ret->ask(0).size));
+        }
+    }
+}
+
 void testTickers() {
     const auto [fst, snd] = readCredentials();
     const auto restClient = std::make_shared<RESTClient>(fst, snd);
@@ -289,13 +469,48 @@ void testTickers() {
     }
 }
 
+bool testRequestBuilderAllocations() {
+    const std::string symbol = "BTCUSDT";
+    const std::string apiKey = "XXXXXXXXXXXXXXXXXX";
+
+    g_numAllocations = 0;
+    g_countAllocations = true;
+
+    RequestBuilder request("/v5/market/kline");
+    request.add("category", Category::linear).add("symbol", symbol).add("interval", CandleInterval::_1).add("start", 1700000000000LL).add("limit", 1000);
+
+    RequestBuilder::SignaturePayload payload;
+    request.writeSignaturePayload(1700000000123LL, apiKey, 5000, payload);
+
+    g_countAllocations = false;
+
+    /// Checked in the Release build as well, not by assert
+    const auto isOK = g_numAllocations == 0 &&
+                      request.target() == "/v5/market/kline?category=linear&symbol=BTCUSDT&interval=1&start=1700000000000&limit=1000" &&
+                      payload.view() == "1700000000123XXXXXXXXXXXXXXXXXX5000category=linear&symbol=BTCUSDT&interval=1&start=1700000000000&limit=1000";
+
+    logFunction(isOK ? vk::LogSeverity::Info : vk::LogSeverity::Error,
+                fmt::format("RequestBuilder heap allocations: {}, target: {}, payload: {}", g_numAllocations.load(), request.target(), payload.view()));
+    return isOK;
+}
+
 int main() {
+    if (!testRequestBuilderAllocations()) {
+        return 1;
+    }
+
     // measureRestResponses();
     // testWebsockets();
+    // testWebsocketUpdates();
+    // testOrderBook();
     // setPositionMode();
     // positions();
     // testOrders();
     testTickers();
     testHistory();
+    // testDownloadHistory();
+    // testBackfill();
+    // testCandleStore();
+    // testCandleFile();
     return getchar();
 }